@@ -6,30 +6,28 @@ _fast int main(void)
     uint32_t calc_op = 0;
     while (1)
     {
-        // Busy-Wait
-        while (!IO_IN(IO_SW)){}
+        // Sleep until a switch is pressed, each press counts once
+        uint32_t pressed = sw_wait_press(PIN_SW1 | PIN_SW2 | PIN_SW3 | PIN_SW4);
 
-        if (IO_IN(IO_SW) & PIN_SW1)
+        if (pressed & PIN_SW1)
         {
             value++;
         }
-        if (IO_IN(IO_SW) & PIN_SW2)
+        if (pressed & PIN_SW2)
         {
             value--;
         }
-        if (IO_IN(IO_SW) & PIN_SW3)
+        if (pressed & PIN_SW3)
         {
             value = 1;
         }
-        if (IO_IN(IO_SW) & PIN_SW4)
+        if (pressed & PIN_SW4)
         {
             value = value << 1;
         }
 
         IO_OUT(IO_SEG_ONE, to_seg((value >> 4) & 0xF));
         IO_OUT(IO_SEG_TWO, to_seg(value & 0xF));
-
-        delay_ms(250);
     }
     return 0;
 }
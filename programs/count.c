@@ -16,10 +16,9 @@ _fast int main(void) {
 
         // Increment num (mod 100);
         num = (num == 99) ? 0 : (num + 1);
-        delay_ms(100);
 
-        // Wait for SW3 to be pressed
-        while (~IO_IN(IO_SW) & PIN_SW3);
+        // Wait for the next press of SW3
+        sw_wait_press(PIN_SW3);
     }
 
     // jump back to init.s, stay in infinite loop
@@ -1,14 +1,17 @@
 #include "ssd1331.h"
 #include "fxp.h"
+#include "timer.h"
 
 // Parameters
 #define CUBE_SZ   (fxp32_t)((1 << 6) << FRAC_BITS)
 #define CAM_DIST  (fxp32_t)((1 << 8) << FRAC_BITS)
 #define CTR_X     (fxp32_t)(48 << FRAC_BITS)
 #define CTR_Y     (fxp32_t)(32 << FRAC_BITS)
+#define FRAME_US  16667u   // 60 frames per second
 
+#if !defined(CORDIC_HW)
 // Sine LUT
-_rodata const fxp32_t sin_quarter[65] = {
+_fastdata const fxp32_t sin_quarter[65] = {
          0,   1608,   3216,   4821,   6424,   8022,   9616,  11204,
      12785,  14359,  15924,  17479,  19024,  20557,  22078,  23586,
      25080,  26558,  28020,  29466,  30893,  32303,  33692,  35062,
@@ -19,6 +22,7 @@ _rodata const fxp32_t sin_quarter[65] = {
      64277,  64571,  64827,  65043,  65220,  65358,  65457,  65516,
      65536
 };
+#endif
 
 // Cube vertices
 _rodata const int8_t verts[24] = {
@@ -39,6 +43,12 @@ _rodata const uint8_t colors[12][3] = {
     {0,0,255}, {127,0,255}, {255,0,255}, {255,0,127}
 };
 
+#if defined(CORDIC_HW)
+// sin and cos of i / 256 turns from fxp_sincos(), on the CORDIC block when present
+_text void get_sincos(uint8_t i, fxp32_t* s, fxp32_t* c) {
+    fxp_sincos((fxp32_t)(((int32_t)(int8_t)i * FXP_PI) >> 7), s, c);
+}
+#else
 // Use Sine LUT
 _text fxp32_t get_sin_val(uint8_t i) {
     uint8_t phase = i & 0x7F;
@@ -54,11 +64,18 @@ _text fxp32_t get_cos_val(uint8_t i) {
     return get_sin_val((uint8_t)(i + 64));
 }
 
+_text void get_sincos(uint8_t i, fxp32_t* s, fxp32_t* c) {
+    *s = get_sin_val(i);
+    *c = get_cos_val(i);
+}
+#endif
+
 _text void transform_vertex(int v_idx, uint8_t ax, uint8_t ay, uint8_t az, int8_t* out_x, int8_t* out_y) {
     // Get trig values
-    fxp32_t sx = get_sin_val(ax), cx = get_cos_val(ax);
-    fxp32_t sy = get_sin_val(ay), cy = get_cos_val(ay);
-    fxp32_t sz = get_sin_val(az), cz = get_cos_val(az);
+    fxp32_t sx, cx, sy, cy, sz, cz;
+    get_sincos(ax, &sx, &cx);
+    get_sincos(ay, &sy, &cy);
+    get_sincos(az, &sz, &cz);
 
     fxp32_t x = (verts[v_idx*3]   > 0) ? CUBE_SZ : -CUBE_SZ;
     fxp32_t y = (verts[v_idx*3+1] > 0) ? CUBE_SZ : -CUBE_SZ;
@@ -142,6 +159,9 @@ _text int main(void) {
 
     uint8_t ax = 0, ay = 0, az = 0;
 
+    frame_pacer_t pacer;
+    frame_pacer_init(&pacer, FRAME_US);
+
     while (1) {
         for (int i = 0; i < 8; i++) {
             transform_vertex(i, ax, ay, az, &cur[i][0], &cur[i][1]);
@@ -155,6 +175,6 @@ _text int main(void) {
         }
 
         ax += 1; ay += 2; az += 1;
-        delay_ms(15);
+        frame_wait(&pacer);
     }
 }
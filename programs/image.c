@@ -14,16 +14,11 @@ _fast int main(void) {
     while (1) {
         const uint16_t* image = images[image_index];
 
-        for (uint16_t i = 0; i < SSD1331_PIXEL_COUNT; i++) {
-            uint16_t color = image[i];
-
-            ssd1331_spi_send(color >> 8);
-            ssd1331_spi_send(color & 0xFF);
-        }
+        ssd1331_blit(image, SSD1331_PIXEL_COUNT);
+        dma_wait();
 
         image_index = (image_index + 1 == NUM_IMAGES) ? 0 : (image_index + 1);
-        delay_ms(100);
-        while (~IO_IN(IO_SW) & PIN_SW3);
+        sw_wait_press(PIN_SW3);
     }
 
     ssd1331_stream_end();
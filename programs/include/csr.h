@@ -0,0 +1,130 @@
+#pragma once
+#include <stdint.h>
+
+/* ========================= CSR numbers ========================= */
+#define CSR_MSTATUS     0x300
+#define CSR_MIE         0x304
+#define CSR_MTVEC       0x305
+#define CSR_MEPC        0x341
+#define CSR_MCAUSE      0x342
+#define CSR_MIP         0x344
+#define CSR_MCYCLE      0xB00
+#define CSR_MINSTRET    0xB02
+#define CSR_MCYCLEH     0xB80
+#define CSR_MINSTRETH   0xB82
+#define CSR_CYCLE       0xC00
+#define CSR_INSTRET     0xC02
+#define CSR_CYCLEH      0xC80
+#define CSR_INSTRETH    0xC82
+#define CSR_MHARTID     0xF14
+#define CSR_MHARTRUN    0x7C0   // custom: bit n lets hart n run
+
+/* ========================= Access ========================= */
+#define _CSR_STR2(x) #x
+#define _CSR_STR(x)  _CSR_STR2(x)
+
+#define CSR_READ(csr) ({ \
+  uint32_t _v; \
+  __asm__ volatile ("csrr %0, " _CSR_STR(csr) : "=r"(_v)); \
+  _v; })
+
+#define CSR_WRITE(csr, val) \
+  __asm__ volatile ("csrw " _CSR_STR(csr) ", %0" :: "rK"((uint32_t)(val)) : "memory")
+
+#define CSR_SET(csr, val) \
+  __asm__ volatile ("csrs " _CSR_STR(csr) ", %0" :: "rK"((uint32_t)(val)) : "memory")
+
+#define CSR_CLEAR(csr, val) \
+  __asm__ volatile ("csrc " _CSR_STR(csr) ", %0" :: "rK"((uint32_t)(val)) : "memory")
+
+/* ========================= Counters ========================= */
+#if defined(__riscv_zicsr)
+static inline uint32_t rdcycle(void)   { return CSR_READ(CSR_CYCLE); }
+static inline uint32_t rdinstret(void) { return CSR_READ(CSR_INSTRET); }
+
+// Re-read the high word in case the low word wrapped in between
+static inline uint64_t rdcycle64(void) {
+  uint32_t hi, lo;
+  do {
+    hi = CSR_READ(CSR_CYCLEH);
+    lo = CSR_READ(CSR_CYCLE);
+  } while (hi != CSR_READ(CSR_CYCLEH));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint64_t rdinstret64(void) {
+  uint32_t hi, lo;
+  do {
+    hi = CSR_READ(CSR_INSTRETH);
+    lo = CSR_READ(CSR_INSTRET);
+  } while (hi != CSR_READ(CSR_INSTRETH));
+  return ((uint64_t)hi << 32) | lo;
+}
+#else
+// Built without Zicsr (e.g. for the pipelined core): counters read as 0
+static inline uint32_t rdcycle(void)     { return 0; }
+static inline uint32_t rdinstret(void)   { return 0; }
+static inline uint64_t rdcycle64(void)   { return 0; }
+static inline uint64_t rdinstret64(void) { return 0; }
+#endif
+
+/* ========================= Region measurement ========================= */
+typedef struct {
+  uint64_t cycles;
+  uint64_t instret;
+} perf_t;
+
+static inline void perf_begin(perf_t* p) {
+  p->instret = rdinstret64();
+  p->cycles  = rdcycle64();
+}
+
+static inline void perf_end(perf_t* p) {
+  p->cycles  = rdcycle64()   - p->cycles;
+  p->instret = rdinstret64() - p->instret;
+}
+
+// Cycles per instruction, times 10 (e.g. 23 = 2.3 CPI)
+static inline uint32_t perf_cpi_x10(const perf_t* p) {
+  uint64_t c = p->cycles * 10u;
+  uint64_t n = p->instret;
+  while ((c >> 32) || (n >> 32)) { c >>= 1; n >>= 1; }
+  return n ? (uint32_t)c / (uint32_t)n : 0;
+}
+
+/* ========================= Traps ========================= */
+#define MSTATUS_MIE     (1u << 3)
+#define MIE_MEIE        (1u << 11)
+#define MIP_MEIP        (1u << 11)
+
+#define MCAUSE_IRQ          (1u << 31)
+#define MCAUSE_ILLEGAL      2u   // reserved compressed encoding
+#define MCAUSE_BREAKPOINT   3u
+#define MCAUSE_ECALL        11u
+#define MCAUSE_EXTERNAL     (MCAUSE_IRQ | 11u)
+
+// Called by the trap vector in init.s with interrupts disabled. Returns
+// the address to resume at: mepc after an interrupt, mepc + 4 to skip
+// an ecall. The default one halts on exceptions (ecall / ebreak, illegal
+// instructions).
+uint32_t trap_handler(uint32_t mcause, uint32_t mepc);
+
+#if defined(__riscv_zicsr)
+static inline void irq_enable(void)  { CSR_SET(CSR_MSTATUS, MSTATUS_MIE); }
+static inline void irq_disable(void) { CSR_CLEAR(CSR_MSTATUS, MSTATUS_MIE); }
+
+// Sleeps until an interrupt enabled in mie is pending, even with
+// mstatus.MIE clear (then no trap is taken)
+static inline void wfi(void) { __asm__ volatile ("wfi" ::: "memory"); }
+#endif
+
+/* ========================= Harts ========================= */
+// With CPU_HARTS > 1 only hart 0 runs after reset. Once started, hart n
+// runs init.s on its own stack (1 KB below hart n - 1) and calls
+// hart_main(n) instead of main. The default hart_main returns at once.
+void hart_main(uint32_t hartid);
+
+#if defined(__riscv_zicsr)
+static inline uint32_t hart_id(void)          { return CSR_READ(CSR_MHARTID); }
+static inline void hart_start(uint32_t mask)  { CSR_SET(CSR_MHARTRUN, mask); }
+#endif
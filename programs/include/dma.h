@@ -0,0 +1,62 @@
+#pragma once
+#include "go-board.h"
+
+/* ========================= DMA engine ========================= */
+// Copies words to RAM from flash (read in bursts) or from RAM, while the
+// core goes on. The core's RAM accesses wait a cycle when they meet a DMA
+// write. DMA_OLED streams flash to the PMOD OLED instead (SCK / MOSI at
+// 6.25 MHz, CS# low and DC high while busy). Built without it,
+// dma_present() is 0 and dma_copy() copies with the core.
+#define DMA_SRC   (IO_DMA + 0x0u)   // byte address, word aligned
+#define DMA_DST   (IO_DMA + 0x4u)   // RAM byte address, word aligned
+#define DMA_LEN   (IO_DMA + 0x8u)   // bytes, rounded up to words, at most 65535; counts down
+#define DMA_CTRL  (IO_DMA + 0xCu)
+
+#define DMA_START    (1u << 0)      // write
+#define DMA_BUSY     (1u << 0)      // read
+#define DMA_DONE     (1u << 1)      // read; write 1 to clear
+#define DMA_OLED     (1u << 2)      // mode: flash to the OLED, DST unused
+#define DMA_SWAP16   (1u << 3)      // mode: halfwords high byte first (RGB565)
+#define DMA_PRESENT  (1u << 31)     // read
+
+#define DMA_MAX_LEN  65535u         // bytes, LEN takes 16 bits
+
+static inline int dma_present(void) { return (IO_IN(DMA_CTRL) & DMA_PRESENT) != 0; }
+static inline int dma_busy(void) { return (IO_IN(DMA_CTRL) & DMA_BUSY) != 0; }
+
+static inline void dma_wait(void) {
+  while (dma_busy()) {}
+}
+
+// Starts copying len bytes from src to dst and returns; dma_busy() is 0
+// (and IRQ_DMA raised) once it is done. Waits for a running copy first.
+// Copies longer than DMA_MAX_LEN are done by the core.
+static inline void dma_copy(void *dst, const void *src, uint32_t len) {
+  if (!dma_present() || len > DMA_MAX_LEN) {
+    const volatile uint32_t *s = (const volatile uint32_t *)src;
+    uint32_t *d = (uint32_t *)dst;
+    for (uint32_t n = (len + 3u) >> 2; n; n--) *d++ = *s++;
+    return;
+  }
+  dma_wait();
+  IO_OUT(DMA_SRC, (uint32_t)(uintptr_t)src);
+  IO_OUT(DMA_DST, (uint32_t)(uintptr_t)dst);
+  IO_OUT(DMA_LEN, len);
+  IO_OUT(DMA_CTRL, DMA_START);
+}
+
+// Starts sending len bytes of flash at src to the OLED as pixel data
+// (ssd1331_blit() sends a whole image this way). Longer than DMA_MAX_LEN
+// it goes out in pieces, waiting for all but the last one.
+static inline void dma_oled(const volatile void *src, uint32_t len, uint32_t mode) {
+  uint32_t a = (uint32_t)(uintptr_t)src;
+  do {
+    uint32_t n = len > DMA_MAX_LEN ? (DMA_MAX_LEN & ~3u) : len;
+    dma_wait();
+    IO_OUT(DMA_SRC, a);
+    IO_OUT(DMA_LEN, n);
+    IO_OUT(DMA_CTRL, DMA_START | DMA_OLED | mode);
+    a += n;
+    len -= n;
+  } while (len);
+}
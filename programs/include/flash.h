@@ -0,0 +1,102 @@
+#pragma once
+#include "go-board.h"
+
+/* ========================= Flash window ========================= */
+// Flash addresses are 24 bits. The first 4 MB read directly from FLASH_BASE
+// on, any 4 MB bank through the asset window (flash_ptr()). The Go-Board's
+// M25P10 holds 128 KB and repeats beyond it.
+#define FLASH_BASE          0x00800000u  // flash byte 0 on the bus
+#define FLASH_ASSET_WINDOW  0x00C00000u
+#define FLASH_BANK_SIZE     0x00400000u
+#define FLASH_BANK  (IO_FLASH + 0xCu)    // flash address of the asset window, 4 MB aligned
+
+// Bus address of a flash byte, past the first 4 MB by moving the window
+static inline const volatile void *flash_ptr(uint32_t offset) {
+  if (offset < FLASH_BANK_SIZE)
+    return (const volatile void *)(uintptr_t)(FLASH_BASE + offset);
+  IO_OUT(FLASH_BANK, offset);
+  return (const volatile void *)(uintptr_t)(FLASH_ASSET_WINDOW + (offset & (FLASH_BANK_SIZE - 1)));
+}
+
+// Flash byte of a bus address
+static inline uint32_t flash_offset(const volatile void *p) {
+  uint32_t a = (uint32_t)(uintptr_t)p - FLASH_BASE;
+  if (a >= FLASH_BANK_SIZE)
+    a = (IO_IN(FLASH_BANK) & ~(FLASH_BANK_SIZE - 1)) | (a & (FLASH_BANK_SIZE - 1));
+  return a;
+}
+
+/* ========================= Flash program / erase ========================= */
+// The M25P10 has 4 sectors of 32 KB. Erasing a sector sets it to 0xFF,
+// programming only clears bits. A command that writes holds the flash
+// controller until the flash is done (page program up to 5 ms, sector
+// erase up to 3 s): flash reads, code fetches included, wait for it and
+// then see the new contents. default.ld leaves the last sector out of the
+// program for _persist data, PERSIST_SIZE is 0 when built with
+// make PERSIST=0 and there is no room for it.
+#define FLASH_SECTOR_SIZE  0x8000u
+
+#ifndef PERSIST_SIZE
+#  define PERSIST_SIZE FLASH_SECTOR_SIZE
+#endif
+
+#define FLASH_CMD   (IO_FLASH + 0x0u)    // opcode << 24 | flash byte address
+#define FLASH_DATA  (IO_FLASH + 0x4u)    // word sent after FLASH_CMD, memory byte order
+#define FLASH_CTRL  (IO_FLASH + 0x8u)    // write: bits to send | FLASH_WAIT, starts
+
+#define FLASH_WAIT  (1u << 8)            // write: poll the flash until it is done
+#define FLASH_BUSY  (1u << 31)           // read: command queued or running
+#define FLASH_STATUS_MASK 0xFFu          // read: last status register read
+
+#define FLASH_SR_WIP  (1u << 0)          // write in progress
+#define FLASH_SR_WEL  (1u << 1)          // write enable latch
+
+#define FLASH_OP_PP    0x02u             // page program
+#define FLASH_OP_RDSR  0x05u             // read status register
+#define FLASH_OP_WREN  0x06u             // write enable
+#define FLASH_OP_SE    0xD8u             // sector erase
+
+static inline void flash_wait(void) {
+  while (IO_IN(FLASH_CTRL) & FLASH_BUSY) {}
+}
+
+// Sends opcode, the low 24 bits of address and data, bits in all (8: the
+// opcode only), once the previous command is done
+static inline void flash_command(uint32_t opcode, uint32_t address, uint32_t data, uint32_t bits) {
+  flash_wait();
+  IO_OUT(FLASH_CMD, (opcode << 24) | (address & 0xFFFFFFu));
+  IO_OUT(FLASH_DATA, data);
+  IO_OUT(FLASH_CTRL, bits);
+}
+
+static inline uint8_t flash_status(void) {
+  flash_command(FLASH_OP_RDSR, 0, 0, 16);
+  flash_wait();
+  return IO_IN(FLASH_CTRL) & FLASH_STATUS_MASK;
+}
+
+static inline void flash_write_enable(void) { flash_command(FLASH_OP_WREN, 0, 0, 8); }
+
+// Erases the 32 KB sector holding p
+static inline void flash_erase_sector(const volatile void *p) {
+  flash_write_enable();
+  flash_command(FLASH_OP_SE, flash_offset(p), 0, 32 | FLASH_WAIT);
+  flash_wait();
+}
+
+// Programs one word at a word aligned p (erased before)
+static inline void flash_program_word(const volatile void *p, uint32_t word) {
+  flash_write_enable();
+  flash_command(FLASH_OP_PP, flash_offset(p), word, 64 | FLASH_WAIT);
+}
+
+// Programs len bytes (rounded up to words) from src to a word aligned dst,
+// skipping erased words
+static inline void flash_program(const volatile void *dst, const void *src, uint32_t len) {
+  const uint32_t *s = (const uint32_t *)src;
+  const volatile uint32_t *d = (const volatile uint32_t *)dst;
+  for (uint32_t n = (len + 3u) >> 2; n; n--, s++, d++) {
+    if (*s != 0xFFFFFFFFu) flash_program_word(d, *s);
+  }
+  flash_wait();
+}
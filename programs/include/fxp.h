@@ -42,6 +42,47 @@ static inline fxp32_t fxp_abs(fxp32_t x) {
     return (x ^ m) - m;
 }
 
+// CORDIC block (CORDIC in src/system.v): write the inputs and the
+// operation, then read the results; a read waits until they are there
+// (16 cycles for sin / cos, 22 for atan2 / magnitude, 24 for sqrt).
+// With CORDIC_HW the functions below check once that the block is there
+// and run in software when it is not.
+#define CORDIC_X     (IO_CORDIC + 0x0u)
+#define CORDIC_Y     (IO_CORDIC + 0x4u)
+#define CORDIC_Z     (IO_CORDIC + 0x8u)
+#define CORDIC_CTRL  (IO_CORDIC + 0xCu)
+
+#define CORDIC_ROTATE  0u   // Z angle            -> X cos, Y sin
+#define CORDIC_VECTOR  1u   // X, Y               -> X magnitude, Z atan2(Y, X)
+#define CORDIC_SQRT    2u   // X                  -> X sqrt
+#define CORDIC_BUSY    (1u << 0)
+#define CORDIC_PRESENT (1u << 31)
+
+#if defined(CORDIC_HW)
+static int8_t _cordic_hw = -1;   // not checked yet
+
+static inline int cordic_present(void) {
+    if (_cordic_hw < 0) _cordic_hw = (IO_IN(CORDIC_CTRL) & CORDIC_PRESENT) != 0;
+    return _cordic_hw;
+}
+#endif
+
+#define FXP_PI    ((fxp32_t)205887)
+#define FXP_PI_2  ((fxp32_t)102944)
+
+#if defined(FXP_HW)
+// custom-0 instructions (CPU_FXP in src/system.v), see riscv_32i.v
+#define _FXP_OP(funct3, a, b) ({ \
+    fxp32_t _r; \
+    __asm__ (".insn r 0x0B, " #funct3 ", 0, %0, %1, %2" \
+             : "=r"(_r) : "r"(a), "r"(b)); \
+    _r; })
+
+static inline fxp32_t fxp_mul(fxp32_t a, fxp32_t b) { return _FXP_OP(0, a, b); }
+static inline fxp32_t fxp_div(fxp32_t a, fxp32_t b) { return _FXP_OP(1, a, b); }
+static inline fxp32_t fxp_sqrt(fxp32_t x)           { return _FXP_OP(2, x, 0); }
+static inline fxp32_t fxp_rsqrt(fxp32_t x)          { return _FXP_OP(3, x, 0); }
+#else
 static inline fxp32_t fxp_mul(fxp32_t a, fxp32_t b) {
     int64_t p = (int64_t)a * (int64_t)b;
     return (fxp32_t)(p >> FRAC_BITS);
@@ -71,7 +112,99 @@ static inline uint32_t isqrt_u64(uint64_t x) {
     return (uint32_t)res;
 }
 
-_fast static fxp32_t fxp_sqrt(fxp32_t x) {
+_fast static fxp32_t _fxp_sqrt_sw(fxp32_t x) {
     if (x <= 0) return 0;
     return (fxp32_t)isqrt_u64(((uint64_t)x) << FRAC_BITS);
 }
+
+static inline fxp32_t fxp_sqrt(fxp32_t x) {
+#if defined(CORDIC_HW)
+    if (cordic_present()) {
+        IO_OUT(CORDIC_X, x);
+        IO_OUT(CORDIC_CTRL, CORDIC_SQRT);
+        return (fxp32_t)IO_IN(CORDIC_X);
+    }
+#endif
+    return _fxp_sqrt_sw(x);
+}
+
+// 1 / sqrt(x)
+static inline fxp32_t fxp_rsqrt(fxp32_t x) {
+    return fxp_div(FXP_ONE, fxp_sqrt(x));
+}
+#endif
+
+// fxp_sincos: sin and cos of an angle in radians, in [-pi, pi]
+// fxp_atan2: atan2(y, x), in [-pi, pi]
+// fxp_hypot: sqrt(x^2 + y^2), for |x|, |y| < 8192
+// Without the block they run the same iterations in software.
+static const fxp32_t _cordic_atan[16] = {
+    51472, 30386, 16055, 8150, 4091, 2047, 1024, 512,
+      256,   128,    64,   32,   16,    8,    4,   2
+};
+
+#define _CORDIC_INV_GAIN ((fxp32_t)39797)
+
+// Turns (x, y) towards z = 0 (rotate) or y = 0 (vector)
+static inline void _cordic(fxp32_t* px, fxp32_t* py, fxp32_t* pz, int vector) {
+    fxp32_t x = *px, y = *py, z = *pz;
+    for (int i = 0; i < 16; i++) {
+        fxp32_t xs = x >> i, ys = y >> i;
+        if (vector ? y < 0 : z >= 0) {
+            x -= ys; y += xs; z -= _cordic_atan[i];
+        } else {
+            x += ys; y -= xs; z += _cordic_atan[i];
+        }
+    }
+    *px = x; *py = y; *pz = z;
+}
+
+static inline fxp32_t _cordic_vector(fxp32_t* x, fxp32_t* y) {
+    fxp32_t z = 0;
+    if (*x < 0) { z = (*y < 0) ? -FXP_PI : FXP_PI; *x = -*x; *y = -*y; }
+    _cordic(x, y, &z, 1);
+    return z;
+}
+
+static inline void fxp_sincos(fxp32_t angle, fxp32_t* s, fxp32_t* c) {
+#if defined(CORDIC_HW)
+    if (cordic_present()) {
+        IO_OUT(CORDIC_Z, angle);
+        IO_OUT(CORDIC_CTRL, CORDIC_ROTATE);
+        *c = (fxp32_t)IO_IN(CORDIC_X);
+        *s = (fxp32_t)IO_IN(CORDIC_Y);
+        return;
+    }
+#endif
+    fxp32_t x = _CORDIC_INV_GAIN, y = 0;
+    if (angle > FXP_PI_2)       { angle -= FXP_PI; x = -x; }
+    else if (angle < -FXP_PI_2) { angle += FXP_PI; x = -x; }
+    _cordic(&x, &y, &angle, 0);
+    *c = x;
+    *s = y;
+}
+
+static inline fxp32_t fxp_atan2(fxp32_t y, fxp32_t x) {
+#if defined(CORDIC_HW)
+    if (cordic_present()) {
+        IO_OUT(CORDIC_X, x);
+        IO_OUT(CORDIC_Y, y);
+        IO_OUT(CORDIC_CTRL, CORDIC_VECTOR);
+        return (fxp32_t)IO_IN(CORDIC_Z);
+    }
+#endif
+    return _cordic_vector(&x, &y);
+}
+
+static inline fxp32_t fxp_hypot(fxp32_t x, fxp32_t y) {
+#if defined(CORDIC_HW)
+    if (cordic_present()) {
+        IO_OUT(CORDIC_X, x);
+        IO_OUT(CORDIC_Y, y);
+        IO_OUT(CORDIC_CTRL, CORDIC_VECTOR);
+        return (fxp32_t)IO_IN(CORDIC_X);
+    }
+#endif
+    _cordic_vector(&x, &y);
+    return fxp_mul(x, _CORDIC_INV_GAIN);
+}
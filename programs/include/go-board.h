@@ -1,14 +1,24 @@
 #pragma once
 #include <stdint.h>
+#include "csr.h"
 
 #if defined(__ELF__) && (defined(__riscv) || defined(__riscv_xlen))
   #define _fast __attribute__((section(".fast"), noinline))
   #define _text __attribute__((section(".text"), noinline))
   #define _rodata __attribute__((section(".rodata")))
+  // Read-only tables copied to RAM at boot, for hot loops
+  #define _fastdata __attribute__((section(".fastdata")))
+  // Flash sector kept out of the program image, written with flash.h
+  #define _persist __attribute__((section(".persist")))
+  // RAM overlay group n (0-3), run after overlay_load(n) from overlay.h
+  #define _overlay(n) __attribute__((section(".overlay" #n), noinline))
 #else
   #define _fast
   #define _text
   #define _rodata
+  #define _fastdata
+  #define _persist
+  #define _overlay(n)
 #endif
 
 /* ========================= MMIO ========================= */
@@ -18,6 +28,19 @@
 #define IO_SEG_TWO    0x0010u
 #define IO_PMOD       0x0020u
 #define IO_SW         0x0040u
+#define IO_IRQ        0x0080u   // pending, write 1 to clear
+#define IO_IRQ_EN     0x0100u
+#define IO_ICACHE_HITS   0x0200u   // instruction cache, write to clear both
+#define IO_ICACHE_MISSES 0x0400u
+
+// Register blocks of 64 KB, registers at 4-byte offsets
+#define IO_DMA        0x00010000u   // dma.h
+#define IO_FLASH      0x00020000u   // flash.h
+#define IO_OLED_SPI   0x00030000u   // ssd1331.h
+#define IO_TIMER      0x00040000u   // timer.h
+#define IO_SWITCH     0x00050000u   // sw_pressed()
+#define IO_RNG        0x00060000u   // random.h
+#define IO_CORDIC     0x00070000u   // fxp.h
 
 #define MMIO32(addr)  (*(volatile uint32_t*)(uintptr_t)(addr))
 #define IO_IN(port)        MMIO32(IO_BASE + (port))
@@ -28,11 +51,55 @@
 #define PIN_SW2    (1u << 2)
 #define PIN_SW1    (1u << 3)
 
+#define IRQ_SW     (1u << 0)    // a switch was pressed (SW_CTRL selects the edges)
+#define IRQ_DMA    (1u << 1)    // a DMA copy is done
+#define IRQ_TIMER  (1u << 2)    // the timer deadline was reached
+
+// Waits until one of the switches in mask is down, sleeping in wfi
+// between presses when the core has interrupts
+static inline void sw_wait(uint32_t mask) {
+#if defined(__riscv_zicsr)
+  IO_OUT(IO_IRQ_EN, IO_IN(IO_IRQ_EN) | IRQ_SW);
+  CSR_SET(CSR_MIE, MIE_MEIE);
+  while (!(IO_IN(IO_SW) & mask)) {
+    wfi();
+    IO_OUT(IO_IRQ, IRQ_SW);
+  }
+#else
+  while (!(IO_IN(IO_SW) & mask)) {}
+#endif
+}
+
+/* ========================= Instruction cache ========================= */
+typedef struct {
+  uint32_t hits;
+  uint32_t misses;
+} icache_stats_t;
+
+static inline void icache_stats_clear(void) { IO_OUT(IO_ICACHE_HITS, 0); }
+
+static inline icache_stats_t icache_stats(void) {
+  icache_stats_t s = { IO_IN(IO_ICACHE_HITS), IO_IN(IO_ICACHE_MISSES) };
+  return s;
+}
+
 /* ========================= Timing ========================= */
 #ifndef CPU_HZ
 #  define CPU_HZ 25000000u
 #endif
 
+#define CYCLES_PER_MS ((CPU_HZ) / 1000u)
+
+#if defined(__riscv_zicsr)
+// Cycle counter based, independent of where the loop is placed
+_fast static void delay_ms(uint32_t ms) {
+  uint32_t t = rdcycle();
+  while (ms--) {
+    t += CYCLES_PER_MS;
+    while ((int32_t)(rdcycle() - t) < 0) {}
+  }
+}
+#else
 #ifndef DELAY_CYCLES_PER_ITER
 #  define DELAY_CYCLES_PER_ITER 12u
 #endif
@@ -43,6 +110,54 @@ _fast static void delay_ms(uint32_t ms) {
   volatile uint32_t t = ms * (uint32_t)DELAY_LOOPS_PER_MS;
   while (t--) __asm__ volatile ("" ::: "memory");
 }
+#endif
+
+/* ========================= Switches ========================= */
+// Debounced switches: each press / release is latched in SW_RISE / SW_FALL
+// until written back, and the edges enabled in SW_CTRL raise IRQ_SW
+// (presses of all switches by default). Without the block (SW_DEBOUNCE = 0
+// in system.v) sw_present() is 0.
+#define SW_STATE   (IO_SWITCH + 0x0u)   // debounced levels
+#define SW_RISE    (IO_SWITCH + 0x4u)   // pressed since cleared; write 1 to clear
+#define SW_FALL    (IO_SWITCH + 0x8u)   // released since cleared; write 1 to clear
+#define SW_CTRL    (IO_SWITCH + 0xCu)   // IRQ_SW masks: presses [3:0], releases [7:4]
+
+#define SW_PRESENT (1u << 31)           // SW_CTRL, read
+
+static inline int sw_present(void) { return (IO_IN(SW_CTRL) & SW_PRESENT) != 0; }
+
+// Switches in mask pressed since the last call, and clears them
+static inline uint32_t sw_pressed(uint32_t mask) {
+  uint32_t p = IO_IN(SW_RISE) & mask;
+  if (p) IO_OUT(SW_RISE, p);
+  return p;
+}
+
+// Waits for a press of one of the switches in mask and returns the ones
+// pressed. Without the debouncer it waits for the switch to be let go
+// again, with a delay either side for contact bounce.
+static inline uint32_t sw_wait_press(uint32_t mask) {
+  if (!sw_present()) {
+    sw_wait(mask);
+    uint32_t p = IO_IN(IO_SW) & mask;
+    delay_ms(20);
+    while (IO_IN(IO_SW) & mask) {}
+    delay_ms(20);
+    return p;
+  }
+  uint32_t p;
+#if defined(__riscv_zicsr)
+  IO_OUT(IO_IRQ_EN, IO_IN(IO_IRQ_EN) | IRQ_SW);
+  CSR_SET(CSR_MIE, MIE_MEIE);
+  while (!(p = sw_pressed(mask))) {
+    wfi();
+    IO_OUT(IO_IRQ, IRQ_SW);
+  }
+#else
+  while (!(p = sw_pressed(mask))) {}
+#endif
+  return p;
+}
 
 /* ========================= 7-segment displays ========================= */
 static const uint8_t digit_map[16] = {
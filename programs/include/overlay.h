@@ -0,0 +1,37 @@
+#pragma once
+#include "go-board.h"
+#include "dma.h"
+
+/* ========================= RAM overlays ========================= */
+// Functions marked _overlay(n) are linked to run from one RAM region shared
+// by the groups 0-3 and stay in flash until overlay_load(n) copies their
+// group there (with the DMA engine when present), replacing the one that
+// was loaded. Call it from code outside the overlays, before calling into
+// the group: OVERLAY_CALL(1, render, frame) does both.
+#define OVERLAY_COUNT 4u
+#define OVERLAY_NONE  0xFFFFFFFFu
+
+extern uint32_t _soverlay[];
+extern const uint32_t __load_start_overlay0[], __load_stop_overlay0[];
+extern const uint32_t __load_start_overlay1[], __load_stop_overlay1[];
+extern const uint32_t __load_start_overlay2[], __load_stop_overlay2[];
+extern const uint32_t __load_start_overlay3[], __load_stop_overlay3[];
+
+extern uint32_t overlay_current;   // in init.s, OVERLAY_NONE at boot
+
+static inline void overlay_load(uint32_t n) {
+  static const uint32_t *const load[OVERLAY_COUNT][2] = {
+    { __load_start_overlay0, __load_stop_overlay0 },
+    { __load_start_overlay1, __load_stop_overlay1 },
+    { __load_start_overlay2, __load_stop_overlay2 },
+    { __load_start_overlay3, __load_stop_overlay3 },
+  };
+
+  if (n == overlay_current || n >= OVERLAY_COUNT) return;
+  uint32_t len = (uint32_t)((uintptr_t)load[n][1] - (uintptr_t)load[n][0]);
+  dma_copy(_soverlay, load[n][0], len);
+  dma_wait();
+  overlay_current = n;
+}
+
+#define OVERLAY_CALL(n, fn, ...) (overlay_load(n), fn(__VA_ARGS__))
@@ -3,16 +3,44 @@
 #include "go-board.h"
 #include "vec3.h"
 
-static uint32_t state = 0;
-
 static _vec3 rand_dir();
 
-_fast static uint32_t random32() {
+static uint32_t state = 0;
+
+_fast static uint32_t _random32_sw(void) {
     state = state * 747796405u + 2891336453u;
     uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
     return (word >> 22u) ^ word;
 }
 
+#if defined(RANDOM_HW)
+// PRNG block (PRNG in src/system.v): a new value on every read, one load
+// instead of the two multiplies above. RNG_SEED restarts the sequence.
+// Checked for once, the software generator runs when it is not there.
+#define RNG_VALUE    (IO_RNG + 0x0u)
+#define RNG_SEED     (IO_RNG + 0x4u)
+#define RNG_PRESENT  (1u << 31)   // RNG_SEED, read
+
+static int8_t _random_hw = -1;   // not checked yet
+
+static inline int random_hw_present(void) {
+    if (_random_hw < 0) _random_hw = (IO_IN(RNG_SEED) & RNG_PRESENT) != 0;
+    return _random_hw;
+}
+
+static inline uint32_t random32(void) {
+    return random_hw_present() ? IO_IN(RNG_VALUE) : _random32_sw();
+}
+
+static inline void random_seed(uint32_t seed) {
+    if (random_hw_present()) IO_OUT(RNG_SEED, seed);
+    else state = seed;
+}
+#else
+static inline uint32_t random32(void) { return _random32_sw(); }
+static inline void random_seed(uint32_t seed) { state = seed; }
+#endif
+
 static uint8_t a, b, c, x;
 static uint8_t rand8() {
   x++;
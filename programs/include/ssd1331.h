@@ -3,6 +3,7 @@
 #include "vec3.h"
 #include "math.h"
 #include "fxp.h"
+#include "dma.h"
 
 /* ---------------- Screen Definitions ---------------- */
 #define SSD1331_WIDTH 96u
@@ -19,12 +20,46 @@
 #define SSD1331_MOSI       (1u << 6)   /* SPI MOSI (DIN)                         */
 #define SSD1331_CS_N       (1u << 7)   /* CHIP SELECT#, active low               */
 
+/* ---------------- SPI master ---------------- */
+// A 4-entry TX FIFO in front of SCK / MOSI: a byte (or a halfword) goes
+// out with its D/C level while the core goes on, CS# is low while the
+// FIFO drains. A store to a full FIFO waits. Enabled, it drives CS#, D/C,
+// SCK and MOSI in place of the PMOD bits, and holds its entries while a
+// DMA stream to the OLED runs. Built without it, the bytes are
+// bit-banged through the PMOD register.
+#define OLED_SPI_TX      (IO_OLED_SPI + 0x0u)
+#define OLED_SPI_STATUS  (IO_OLED_SPI + 0x4u)
+#define OLED_SPI_CTRL    (IO_OLED_SPI + 0x8u)
+
+#define OLED_SPI_HALF     (1u << 16)   // TX: send data[15:0], high byte first
+#define OLED_SPI_DC       (1u << 17)   // TX: D/C level for this entry
+#define OLED_SPI_BUSY     (1u << 8)    // STATUS: FIFO or shifter not empty
+#define OLED_SPI_PRESENT  (1u << 31)   // STATUS
+#define OLED_SPI_ENABLE   (1u << 8)    // CTRL, with the SCK divider in [7:0]
+#define OLED_SPI_DIV      1u           // SCK = CPU_HZ / (2 * (DIV + 1)), 6.25 MHz
+
+static uint8_t _oled_spi = 0;
+
+static inline void oled_spi_wait(void) {
+  while (IO_IN(OLED_SPI_STATUS) & OLED_SPI_BUSY) {}
+}
+
 /* ---------------- MMIO helpers ---------------- */
 #define _PMOD_PORT   (*(volatile uint32_t*)(uintptr_t)(IO_BASE + IO_PMOD))
 
+// Pins the SPI master drives in place of the PMOD register
+#define _PMOD_SPI_BITS (SSD1331_CS_N | SSD1331_DC | SSD1331_SCLK | SSD1331_MOSI)
+
 static volatile uint32_t _pmod_state = 0;
 static inline void _pmod_write(uint32_t v) { _PMOD_PORT = v; }
-static inline void _pmod_write_state(uint32_t v) { _pmod_state = v; _PMOD_PORT = v; }
+// Waits for a DMA stream to the OLED (ssd1331_blit) to finish first, and
+// for the SPI master to drain before reset or the rails change
+static inline void _pmod_write_state(uint32_t v) {
+  dma_wait();
+  if (_oled_spi && ((v ^ _pmod_state) & ~_PMOD_SPI_BITS)) oled_spi_wait();
+  _pmod_state = v;
+  _PMOD_PORT = v;
+}
 
 /* ---------------- Safe idle / rail defaults ---------------- */
 static inline void pmod_init(void) {
@@ -32,6 +67,9 @@ static inline void pmod_init(void) {
   v |=  (SSD1331_CS_N | SSD1331_RES_N | SSD1331_PMOD_EN);
   v &= ~(SSD1331_SCLK | SSD1331_MOSI | SSD1331_DC | SSD1331_VCC_EN);
   _pmod_write_state(v);
+
+  _oled_spi = (IO_IN(OLED_SPI_STATUS) & OLED_SPI_PRESENT) != 0;
+  if (_oled_spi) IO_OUT(OLED_SPI_CTRL, OLED_SPI_ENABLE | OLED_SPI_DIV);
 }
 
 static inline void pmod_set(uint32_t m) { _pmod_write_state(_pmod_state |  m); }
@@ -104,6 +142,13 @@ typedef enum {
 
 /* ---------------- SPI ---------------- */
 _fast static void ssd1331_spi_send(uint8_t byte) {
+    if (_oled_spi) {
+        IO_OUT(OLED_SPI_TX, byte | ((_pmod_state & SSD1331_DC) ? OLED_SPI_DC : 0));
+        return;
+    }
+
+    // The PMOD pins belong to a DMA stream to the OLED until it is done
+    dma_wait();
     uint32_t v = _pmod_state & ~(SSD1331_SCLK | SSD1331_MOSI);
     volatile uint32_t* const P = &_PMOD_PORT;
     *P = v;
@@ -176,11 +221,24 @@ static inline uint8_t clamp_u8(int32_t v) {
     return v < 0 ? 0 : v > 255 ? 255 : (uint8_t)v;
 }
 
-static inline void ssd1331_send_vec3(_vec3 v) {
+static inline uint16_t ssd1331_rgb565_vec3(_vec3 v) {
     int32_t r = fxp_clamp(v.x * 255, 0, 255 << FRAC_BITS) >> FRAC_BITS;
     int32_t g = fxp_clamp(v.y * 255, 0, 255 << FRAC_BITS) >> FRAC_BITS;
     int32_t b = fxp_clamp(v.z * 255, 0, 255 << FRAC_BITS) >> FRAC_BITS;
-    _ssd1331_send_color(q5(r), q6(g), q5(b));
+    return (uint16_t)((q5(r) << 11) | (q6(g) << 5) | q5(b));
+}
+
+static inline void ssd1331_send_rgb565(uint16_t c) {
+    if (_oled_spi) {
+        IO_OUT(OLED_SPI_TX, c | OLED_SPI_HALF | ((_pmod_state & SSD1331_DC) ? OLED_SPI_DC : 0));
+        return;
+    }
+    ssd1331_spi_send(c >> 8);
+    ssd1331_spi_send(c & 0xFF);
+}
+
+static inline void ssd1331_send_vec3(_vec3 v) {
+    ssd1331_send_rgb565(ssd1331_rgb565_vec3(v));
 }
 
 /* ---------------- Pixel streaming helpers (DC=1 only for pixel bytes) ---------------- */
@@ -194,6 +252,21 @@ static inline void ssd1331_stream_begin(void)       {
 static inline void ssd1331_stream_byte(uint8_t b)   { ssd1331_spi_send(b); }
 static inline void ssd1331_stream_end(void)         { ssd1331_cs_deassert(); }
 
+// Sends count RGB565 pixels from flash, with the DMA engine when there is
+// one, else bit by bit. The DMA stream returns at once: a later PMOD write
+// or bit-banged byte waits for it, and SPI master entries stay queued
+// (the FIFO holds) until it is done.
+// Call between ssd1331_stream_begin() and ssd1331_stream_end().
+static inline void ssd1331_blit(const volatile uint16_t* pixels, uint32_t count) {
+    if (dma_present()) {
+        if (_oled_spi) oled_spi_wait();
+        dma_oled(pixels, count * 2u, DMA_SWAP16);
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++)
+        ssd1331_send_rgb565(pixels[i]);
+}
+
 /* ---------------- Address window (params with DC=0) ---------------- */
 static void ssd1331_set_addr_window(uint8_t x, uint8_t y, uint8_t w, uint8_t h) {
     uint8_t x1 = x;
@@ -0,0 +1,102 @@
+#pragma once
+#include "go-board.h"
+
+/* ========================= Timer ========================= */
+// A counter that runs at a fixed rate whatever the core is doing and
+// wherever the code lives: TIMER_US counts microseconds since reset (CPU
+// cycles are rdcycle64() in csr.h). TIMER_US wraps after 71 minutes, so
+// compare times with a signed difference (time_reached()). TIMER_CMP
+// raises IRQ_TIMER once TIMER_US reaches it. Without the timer
+// (TIMER = 0 in system.v) timer_present() is 0, sleep_until() returns at
+// once and delay_us() / frame_wait() fall back to busy waiting.
+#define TIMER_US        (IO_TIMER + 0x00u)   // writable
+#define TIMER_CMP       (IO_TIMER + 0x04u)   // deadline in us; a write arms it
+#define TIMER_CTRL      (IO_TIMER + 0x08u)
+
+#define TIMER_EXPIRED   (1u << 0)   // read; write 1 to clear
+#define TIMER_ARMED     (1u << 1)   // read
+#define TIMER_DISARM    (1u << 1)   // write
+#define TIMER_PRESENT   (1u << 31)  // read
+
+static inline int timer_present(void) { return (IO_IN(TIMER_CTRL) & TIMER_PRESENT) != 0; }
+
+static inline uint32_t now_us(void) { return IO_IN(TIMER_US); }
+
+static inline int time_reached(uint32_t t) { return (int32_t)(now_us() - t) >= 0; }
+
+// Waits until now_us() reaches t, sleeping in wfi when the core has
+// interrupts. Returns at once when t is already past.
+static inline void sleep_until(uint32_t t) {
+  if (!timer_present()) return;
+#if defined(__riscv_zicsr)
+  IO_OUT(IO_IRQ, IRQ_TIMER);
+  IO_OUT(TIMER_CMP, t);
+  IO_OUT(IO_IRQ_EN, IO_IN(IO_IRQ_EN) | IRQ_TIMER);
+  CSR_SET(CSR_MIE, MIE_MEIE);
+  while (!(IO_IN(TIMER_CTRL) & TIMER_EXPIRED)) {
+    wfi();
+    IO_OUT(IO_IRQ, IRQ_TIMER);
+  }
+#else
+  IO_OUT(TIMER_CMP, t);
+  while (!(IO_IN(TIMER_CTRL) & TIMER_EXPIRED)) {}
+#endif
+}
+
+static inline void delay_us(uint32_t us) {
+  if (timer_present()) {
+    sleep_until(now_us() + us);
+    return;
+  }
+#if defined(__riscv_zicsr)
+  uint32_t t = rdcycle() + us * ((CPU_HZ) / 1000000u);
+  while ((int32_t)(rdcycle() - t) < 0) {}
+#else
+  volatile uint32_t t = us * (((CPU_HZ) / 1000000u + DELAY_CYCLES_PER_ITER - 1) / DELAY_CYCLES_PER_ITER);
+  while (t--) __asm__ volatile ("" ::: "memory");
+#endif
+}
+
+/* ========================= Frame pacing ========================= */
+// Fixed-rate loop: frame_wait() returns period_us after the previous
+// frame started, however long the frame took to draw. A frame that ran
+// past its slot starts the next one from now instead of catching up.
+// Without the timer the deadlines are kept in mcycle counts; only a
+// build without Zicsr, which has no time base at all, waits a whole
+// period after each frame.
+typedef struct {
+  uint32_t next;
+  uint32_t period;   // in us with the timer, else in cycles (Zicsr)
+  uint8_t timer;
+} frame_pacer_t;
+
+#if defined(__riscv_zicsr)
+#  define _PACER_CYCLES_PER_US ((CPU_HZ) / 1000000u)
+#else
+#  define _PACER_CYCLES_PER_US 1u   // period stays in us for delay_us()
+#endif
+
+static inline uint32_t _pacer_now(const frame_pacer_t* p) {
+  return p->timer ? now_us() : rdcycle();
+}
+
+static inline void frame_pacer_init(frame_pacer_t* p, uint32_t period_us) {
+  p->timer = timer_present();
+  p->period = p->timer ? period_us : period_us * _PACER_CYCLES_PER_US;
+  p->next = _pacer_now(p) + p->period;
+}
+
+static inline void frame_wait(frame_pacer_t* p) {
+  if (p->timer) {
+    sleep_until(p->next);
+  } else {
+#if defined(__riscv_zicsr)
+    while ((int32_t)(rdcycle() - p->next) < 0) {}
+#else
+    delay_us(p->period);
+    return;
+#endif
+  }
+  p->next += p->period;
+  if ((int32_t)(_pacer_now(p) - p->next) >= 0) p->next = _pacer_now(p) + p->period;
+}
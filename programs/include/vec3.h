@@ -91,7 +91,11 @@ static inline fxp32_t vec3_len(_vec3 v) {
 }
 
 static inline _vec3 vec3_normalize(_vec3 v) {
+#if defined(FXP_HW)
+    return vec3_mul_fxp(v, fxp_rsqrt(vec3_lensqr(v)));
+#else
     return vec3_div_fxp(v, vec3_len(v));
+#endif
 }
 
 static inline _vec3 vec3_unit_to_uniform01(_vec3 v) {
@@ -1,4 +1,8 @@
 .equ IO_BASE, 0x400000
+.equ HART_STACK_SHIFT, 10   # 1 KB stack per hart, hart n below hart n - 1
+.equ DMA_BASE, 0x410000     # IO_DMA
+.equ DMA_LEN, 0x8
+.equ DMA_CTRL, 0xC
 
 .section .text.init.entry,"ax",@progbits
 .global _start
@@ -9,7 +13,15 @@ _start:
 .option norelax
     li   gp, IO_BASE
 .option pop
-    li   sp, 0x1800
+    la   sp, _stack_top
+
+# 0) Harts other than 0 skip the initialisation
+.ifdef ZICSR
+    csrr a0, mhartid
+    slli t0, a0, HART_STACK_SHIFT
+    sub  sp, sp, t0
+    bnez a0, _hart_start
+.endif
 
 # 1) Clear .bss
     la a0, _sbss
@@ -25,29 +37,143 @@ _start:
     la a0, _sfast_load
     la a1, _sfast
     la a2, _efast
-    bge a1, a2, 2f
-0:
-    lw a3, 0(a0)
-    sw a3, 0(a1)
-    addi a0, a0, 4
-    addi a1, a1, 4
-    blt a1, a2, 0b
-2:
+    call _copy
+
+# 3) Copy .fastdata and .data (FLASH -> RAM)
+    la a0, _sfastdata_load
+    la a1, _sfastdata
+    la a2, _efastdata
+    call _copy
 
-# 3) Copy .data (FLASH -> RAM)
     la a0, _sdata_load
     la a1, _sdata
     la a2, _edata
-    bge a1, a2, 3f
-0:
-    lw a3, 0(a0)
-    sw a3, 0(a1)
-    addi a0, a0, 4
-    addi a1, a1, 4
-    blt a1, a2, 0b
-3:
+    call _copy
+
+# 4) Point traps at _trap_vector (now in RAM)
+.ifdef ZICSR
+    la   a0, _trap_vector
+    csrw mtvec, a0
+.endif
 
-# 4) Jump to C
+# 5) Jump to C
     call main
     ebreak
 0:  j 0b
+
+# Copies words from a0 to a1 up to a2, with the DMA engine when there is
+# one (burst flash reads), else one lw / sw at a time
+_copy:
+    bge  a1, a2, 2f
+    li   t0, DMA_BASE
+    lw   t1, DMA_CTRL(t0)
+    bgez t1, 1f                 # DMA_PRESENT is bit 31
+    sw   a0, 0(t0)
+    sw   a1, 4(t0)
+    sub  t1, a2, a1
+    sw   t1, DMA_LEN(t0)
+    li   t1, 1
+    sw   t1, DMA_CTRL(t0)
+0:  lw   t1, DMA_CTRL(t0)
+    andi t1, t1, 1              # DMA_BUSY
+    bnez t1, 0b
+    ret
+1:  lw   a3, 0(a0)
+    sw   a3, 0(a1)
+    addi a0, a0, 4
+    addi a1, a1, 4
+    blt  a1, a2, 1b
+2:  ret
+
+.ifdef ZICSR
+# Harts started through mhartrun: hart_main(mhartid), then clear their own
+# mhartrun bit, which parks them for good
+_hart_start:
+    call hart_main
+    csrr a0, mhartid
+    li   t0, 1
+    sll  t0, t0, a0
+    csrc 0x7C0, t0
+0:  j 0b
+
+.section .text.hart_main,"ax",@progbits
+.weak hart_main
+.type hart_main, @function
+
+hart_main:
+    ret
+
+# Trap vector: saves the caller-saved registers and calls
+#   uint32_t trap_handler(uint32_t mcause, uint32_t mepc)
+# on the current stack, then resumes at the address it returns.
+# Kept in .fast so interrupt entry does not fetch from flash.
+.section .fast.trap,"ax",@progbits
+.balign 4
+.global _trap_vector
+.type _trap_vector, @function
+
+_trap_vector:
+    addi sp, sp, -64
+    sw   ra,  0(sp)
+    sw   t0,  4(sp)
+    sw   t1,  8(sp)
+    sw   t2, 12(sp)
+    sw   a0, 16(sp)
+    sw   a1, 20(sp)
+    sw   a2, 24(sp)
+    sw   a3, 28(sp)
+    sw   a4, 32(sp)
+    sw   a5, 36(sp)
+    sw   a6, 40(sp)
+    sw   a7, 44(sp)
+    sw   t3, 48(sp)
+    sw   t4, 52(sp)
+    sw   t5, 56(sp)
+    sw   t6, 60(sp)
+
+    csrr a0, mcause
+    csrr a1, mepc
+    call trap_handler
+    csrw mepc, a0
+
+    lw   ra,  0(sp)
+    lw   t0,  4(sp)
+    lw   t1,  8(sp)
+    lw   t2, 12(sp)
+    lw   a0, 16(sp)
+    lw   a1, 20(sp)
+    lw   a2, 24(sp)
+    lw   a3, 28(sp)
+    lw   a4, 32(sp)
+    lw   a5, 36(sp)
+    lw   a6, 40(sp)
+    lw   a7, 44(sp)
+    lw   t3, 48(sp)
+    lw   t4, 52(sp)
+    lw   t5, 56(sp)
+    lw   t6, 60(sp)
+    addi sp, sp, 64
+    mret
+
+# Default handler: interrupts return to where they hit, exceptions (ecall /
+# ebreak, including the one after main, and illegal instructions) halt.
+.section .text.trap_handler,"ax",@progbits
+.weak trap_handler
+.type trap_handler, @function
+
+trap_handler:
+    bltz a0, 1f
+0:  j 0b
+1:  mv   a0, a1
+    ret
+.endif
+
+# The overlay group loaded in RAM (overlay.h), one copy for every file
+# that includes it; none at boot
+.section .data.overlay_current,"aw",@progbits
+.global overlay_current
+.type overlay_current, @object
+.balign 4
+
+overlay_current:
+    .word 0xFFFFFFFF
@@ -1,21 +1,23 @@
 #include <go-board.h>
 #include <ssd1331.h>
+#include <overlay.h>
 
-_fast static void gradient_h(void) {
+// One pattern per overlay group, loaded into RAM when it is drawn
+_overlay(0) static void gradient_h(void) {
     for (int x = 0; x < SSD1331_WIDTH; x++) {
         uint8_t v = (uint8_t)((x * 255) / (SSD1331_WIDTH - 1));
         draw_line_color((uint8_t)x, 0, (uint8_t)x, (uint8_t)(SSD1331_HEIGHT - 1), v, v, v);
     }
 }
 
-_fast static void gradient_v(void) {
+_overlay(1) static void gradient_v(void) {
     for (int y = 0; y < SSD1331_HEIGHT; y++) {
         uint8_t v = (uint8_t)((y * 255) / (SSD1331_HEIGHT - 1));
         draw_line_color(0, (uint8_t)y, (uint8_t)(SSD1331_WIDTH - 1), (uint8_t)y, v, v, v);
     }
 }
 
-_fast static void checkerboard(void) {
+_overlay(2) static void checkerboard(void) {
     const int tile = 8;
 
     fill_solid(255, 255, 255);
@@ -30,7 +32,7 @@ _fast static void checkerboard(void) {
     }
 }
 
-_fast static void color_bars(void) {
+_overlay(3) static void color_bars(void) {
     draw_filled_rect(0,   0, 12, SSD1331_HEIGHT, 255, 0,   0  ); // Red
     draw_filled_rect(12,  0, 12, SSD1331_HEIGHT, 255, 255, 0  ); // Yellow
     draw_filled_rect(24,  0, 12, SSD1331_HEIGHT, 0,   255, 0  ); // Green
@@ -53,10 +55,10 @@ _fast int main(void) {
             case 1: fill_solid(255, 0,   0  ); break;
             case 2: fill_solid(0,   255, 0  ); break;
             case 3: fill_solid(0,   0,   255); break;
-            case 4: gradient_h();              break;
-            case 5: gradient_v();              break;
-            case 6: checkerboard();            break;
-            default: color_bars();             break;
+            case 4: OVERLAY_CALL(0, gradient_h);   break;
+            case 5: OVERLAY_CALL(1, gradient_v);   break;
+            case 6: OVERLAY_CALL(2, checkerboard); break;
+            default: OVERLAY_CALL(3, color_bars);  break;
         }
 
         delay_ms(250);
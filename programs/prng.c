@@ -10,6 +10,9 @@ _fast int main(void) {
     const uint32_t step = TOTAL / 100u;
     uint32_t next_event = 0;
 
+    perf_t perf;
+    perf_begin(&perf);
+
     for (uint32_t i = 0; i < TOTAL; i++) {
         if (i == next_event) {
             uint32_t high = to_seg((progress / 10) % 10);
@@ -25,8 +28,15 @@ _fast int main(void) {
         state = random32();
     }
 
-    IO_OUT(IO_SEG_ONE, to_seg((state / 10) % 10));
-    IO_OUT(IO_SEG_TWO, to_seg((state) % 10));
+    perf_end(&perf);
+
+    // Show CPI * 10 for the loop, e.g. 2.3 -> "23"
+    uint32_t cpi = perf_cpi_x10(&perf);
+    if (cpi > 99) cpi = 99;
+
+    IO_OUT(IO_SEG_ONE, to_seg((cpi / 10) % 10));
+    IO_OUT(IO_SEG_TWO, to_seg(cpi % 10));
+    IO_OUT(IO_LEDS, state & 0xF);
 
     return 0;
 }
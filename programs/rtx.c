@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <vec3.h>
 #include <fxp.h>
+#include <flash.h>
 #include <string.h>
 
 #define NUM_SPHERES 2
@@ -12,6 +13,15 @@
 #define RAYS_PER_PIXEL 1024
 #define MAX_BOUNCES 4
 
+// The last render, kept in flash and shown at once on the next boot (hold
+// SW4 at boot to render again). Built with make PERSIST=0 it is not kept.
+#define FRAME_PIXELS (SSD1331_HEIGHT * SSD1331_HEIGHT)
+#define FRAME_SAVED 0x52545831u
+#if PERSIST_SIZE
+_persist static const volatile uint16_t saved_frame[FRAME_PIXELS];
+_persist static const volatile uint32_t saved_frame_tag;
+#endif
+
 typedef struct _ray {
     _vec3 origin, dir;
 } _ray;
@@ -184,6 +194,9 @@ _vec3 get_color(_ray* ray) {
 
 int main(void) {
     uint32_t rendered_pixels = 0;
+#if PERSIST_SIZE
+    uint32_t pair = 0;
+#endif
 
     ssd1331_init();
 
@@ -191,6 +204,18 @@ int main(void) {
     ssd1331_cmd0(SSD1331_CMD_WRITE_RAM);
     ssd1331_stream_begin();
 
+#if PERSIST_SIZE
+    if (saved_frame_tag == FRAME_SAVED && !(IO_IN(IO_SW) & PIN_SW4)) {
+        ssd1331_blit(saved_frame, FRAME_PIXELS);
+        ssd1331_stream_end();
+        return 0;
+    }
+    flash_erase_sector(saved_frame);
+#endif
+
+    perf_t perf;
+    perf_begin(&perf);
+
     for (uint8_t y = 0; y < SSD1331_HEIGHT; y++) {
         for (uint8_t x = 0; x < SSD1331_HEIGHT; x++) {
             _vec3 color = {0, 0, 0};
@@ -209,7 +234,18 @@ int main(void) {
                 color = vec3_add_vec3(color, get_color(&ray));
             }
 
-            ssd1331_send_vec3(vec3_div_int32(color, RAYS_PER_PIXEL));
+            uint16_t pixel = ssd1331_rgb565_vec3(vec3_div_int32(color, RAYS_PER_PIXEL));
+            ssd1331_send_rgb565(pixel);
+
+#if PERSIST_SIZE
+            // Two pixels to a flash word
+            if (x & 1) {
+                uint32_t i = (uint32_t)y * SSD1331_HEIGHT + x - 1;
+                flash_program_word(&saved_frame[i], pair | ((uint32_t)pixel << 16));
+            } else {
+                pair = pixel;
+            }
+#endif
 
             rendered_pixels++;
             IO_OUT(IO_SEG_ONE, to_seg((rendered_pixels >> 4) % 0xF));
@@ -219,5 +255,17 @@ int main(void) {
 
     ssd1331_stream_end();
 
+    perf_end(&perf);
+#if PERSIST_SIZE
+    flash_program_word(&saved_frame_tag, FRAME_SAVED);
+#endif
+
+    // Show CPI * 10 of the render, e.g. 2.3 -> "23"
+    uint32_t cpi = perf_cpi_x10(&perf);
+    if (cpi > 99) cpi = 99;
+
+    IO_OUT(IO_SEG_ONE, to_seg((cpi / 10) % 10));
+    IO_OUT(IO_SEG_TWO, to_seg(cpi % 10));
+
     return 0;
 }
@@ -0,0 +1,169 @@
+`default_nettype none
+
+// Iterative CORDIC for Q16.16 trigonometry, one iteration per cycle:
+//   ROTATE  Z = angle in [-pi, pi]    ->  X = cos, Y = sin         16 cycles
+//   VECTOR  X, Y (|X|, |Y| < 8192)    ->  Z = atan2(Y, X),
+//                                         X = sqrt(X^2 + Y^2)       22 cycles
+//   SQRT    X >= 0                    ->  X = sqrt(X), one root bit
+//                                         per cycle (as fsqrt)      24 cycles
+// ROTATE starts from X = 1 / gain, so it needs no correction. VECTOR
+// scales the magnitude back by the gain with 6 shift-and-add steps
+// (1/2 + 1/8 - 1/64 - 1/512 - 1/4096 + 1/16384, within 2^-16 of it).
+// Angles outside [-pi/2, pi/2] are turned by pi first. Results are good
+// to about 2^-12 (a few LSBs of Q16.16).
+//
+// Registers: 0 X, 1 Y, 2 Z, 3 CTRL: write the operation to start it,
+// reads {present, ..., busy}. system.v holds X / Y / Z accesses on
+// mem_ready while busy, so a read right after the start gets the result.
+module cordic (
+  input clk,
+  input reset,
+
+  // Registers
+  input wstrb,
+  input [1:0] reg_addr,
+  input [31:0] wdata,
+  output reg [31:0] rdata,
+  output reg busy
+);
+
+localparam REG_X = 0;
+localparam REG_Y = 1;
+localparam REG_Z = 2;
+localparam REG_CTRL = 3;
+
+localparam OP_ROTATE = 2'd0;
+localparam OP_VECTOR = 2'd1;
+localparam OP_SQRT = 2'd2;
+
+localparam signed [31:0] PI = 32'sd205887;
+localparam signed [31:0] PI_2 = 32'sd102944;
+localparam signed [31:0] INV_GAIN = 32'sd39797;  // 0.60725
+
+reg signed [31:0] x, y, z;
+reg [1:0] op;
+reg [4:0] step;
+
+initial busy = 1'b0;
+
+// atan(2^-i) for the iteration i = step
+reg signed [31:0] atan;
+always @(*) begin
+    case (step[3:0])
+        4'd0: atan = 32'd51472;
+        4'd1: atan = 32'd30386;
+        4'd2: atan = 32'd16055;
+        4'd3: atan = 32'd8150;
+        4'd4: atan = 32'd4091;
+        4'd5: atan = 32'd2047;
+        4'd6: atan = 32'd1024;
+        4'd7: atan = 32'd512;
+        4'd8: atan = 32'd256;
+        4'd9: atan = 32'd128;
+        4'd10: atan = 32'd64;
+        4'd11: atan = 32'd32;
+        4'd12: atan = 32'd16;
+        4'd13: atan = 32'd8;
+        4'd14: atan = 32'd4;
+        default: atan = 32'd2;
+    endcase
+end
+
+// Gain correction, steps 16-21: {subtract, shift}
+reg [4:0] gain_term;
+always @(*) begin
+    case (step[2:0])
+        3'd0: gain_term = {1'b0, 4'd1};
+        3'd1: gain_term = {1'b0, 4'd3};
+        3'd2: gain_term = {1'b1, 4'd6};
+        3'd3: gain_term = {1'b1, 4'd9};
+        3'd4: gain_term = {1'b1, 4'd12};
+        default: gain_term = {1'b0, 4'd14};
+    endcase
+end
+
+wire gain_step = step[4];
+wire [3:0] x_shift = gain_step ? gain_term[3:0] : step[3:0];
+wire signed [31:0] xs = x >>> x_shift;
+wire signed [31:0] ys = y >>> step[3:0];
+
+// Turn towards Z = 0 (ROTATE) or Y = 0 (VECTOR)
+wire ccw = (op == OP_ROTATE) ? ~z[31] : y[31];
+
+// SQRT: X is the root, Y the remainder, Z the radicand
+wire [31:0] rem = {y[29:0], z[31:30]};
+wire [31:0] trial = {x[29:0], 2'b01};
+wire fits = rem >= trial;
+
+wire is_sqrt = op[1];   // OP_SQRT, or 3
+
+wire last =
+    is_sqrt ? step == 5'd23 :
+    (op == OP_VECTOR) ? step == 5'd21 :
+    step == 5'd15;
+
+wire start = wstrb & (reg_addr == REG_CTRL) & ~busy;
+
+always @(*) begin
+    case (reg_addr)
+        REG_X: rdata = x;
+        REG_Y: rdata = y;
+        REG_Z: rdata = z;
+        default: rdata = {1'b1, 30'b0, busy};
+    endcase
+end
+
+always @(posedge clk) begin
+    if (reset) begin
+        busy <= 1'b0;
+    end else if (start) begin
+        busy <= 1'b1;
+        op <= wdata[1:0];
+        step <= 5'd0;
+
+        case (wdata[1:0])
+            OP_ROTATE: begin
+                x <= (z > PI_2 || z < -PI_2) ? -INV_GAIN : INV_GAIN;
+                y <= 32'sd0;
+                z <= (z > PI_2) ? z - PI : (z < -PI_2) ? z + PI : z;
+            end
+            OP_VECTOR: begin
+                x <= x[31] ? -x : x;
+                y <= x[31] ? -y : y;
+                z <= ~x[31] ? 32'sd0 : y[31] ? -PI : PI;
+            end
+            default: begin
+                x <= 32'sd0;
+                y <= 32'sd0;
+                z <= x[31] ? 32'sd0 : x;
+            end
+        endcase
+    end else if (busy) begin
+        step <= step + 1'b1;
+        if (last) busy <= 1'b0;
+
+        if (is_sqrt) begin
+            y <= fits ? rem - trial : rem;
+            x <= {x[30:0], fits};
+            z <= z << 2;
+        end else if (gain_step) begin
+            // Y collects the magnitude, the last step puts it in X
+            if (last) begin
+                x <= y + xs;
+                y <= 32'sd0;
+            end else begin
+                y <= (step[2:0] == 3'd0) ? xs : gain_term[4] ? y - xs : y + xs;
+            end
+        end else begin
+            x <= ccw ? x - ys : x + ys;
+            y <= ccw ? y + xs : y - xs;
+            z <= ccw ? z - atan : z + atan;
+        end
+    end else if (wstrb) begin
+        if (reg_addr == REG_X) x <= wdata;
+        if (reg_addr == REG_Y) y <= wdata;
+        if (reg_addr == REG_Z) z <= wdata;
+    end
+end
+
+endmodule
@@ -0,0 +1,96 @@
+`default_nettype none
+
+// Debounced switches with latched edges. A switch changes state once its
+// input has held the new level for STABLE ticks of 2^TICK_BITS cycles
+// (8 x 0.65 ms at 25 MHz); each change sets its bit in RISE (pressed) or
+// FALL (released) until software writes 1 to it, so no press is lost
+// however long the core takes to look. The edges selected in CTRL also
+// raise the IRQ_SW pending bit (changed).
+//
+// Registers: 0 STATE (debounced levels), 1 RISE, 2 FALL (write 1 to
+// clear), 3 CTRL ({fall irq mask, rise irq mask}, rises of all switches at
+// reset; reads {present, ..., masks}).
+module debounce #(
+  parameter N = 4,
+  parameter TICK_BITS = 14,
+  parameter STABLE = 8
+) (
+  input clk,
+  input reset,
+  input [N-1:0] switches,
+
+  // Registers
+  input wstrb,
+  input [1:0] reg_addr,
+  input [31:0] wdata,
+  output reg [31:0] rdata,
+  output changed           // one cycle when a selected edge is latched
+);
+
+localparam REG_STATE = 0;
+localparam REG_RISE = 1;
+localparam REG_FALL = 2;
+localparam REG_CTRL = 3;
+
+reg [N-1:0] sync_a, sync_b;
+reg [N-1:0] state = {N{1'b0}};
+reg [N-1:0] rise = {N{1'b0}};
+reg [N-1:0] fall = {N{1'b0}};
+reg [N-1:0] rise_mask;
+reg [N-1:0] fall_mask;
+
+reg [TICK_BITS-1:0] prescale = 0;
+
+wire tick = &prescale;
+
+wire [N-1:0] flip;
+genvar i;
+generate
+for (i = 0; i < N; i = i + 1) begin : sw
+  reg [2:0] count = 3'd0; // ticks the input has differed from state
+
+  assign flip[i] = tick & (sync_b[i] != state[i]) & (count == STABLE - 1);
+
+  always @(posedge clk) begin
+      if ((sync_b[i] == state[i]) | flip[i])
+          count <= 3'd0;
+      else if (tick)
+          count <= count + 1'b1;
+  end
+end
+endgenerate
+
+wire [N-1:0] new_rise = flip & ~state;
+wire [N-1:0] new_fall = flip & state;
+
+assign changed = |((new_rise & rise_mask) | (new_fall & fall_mask));
+
+always @(*) begin
+    case (reg_addr)
+        REG_STATE: rdata = state;
+        REG_RISE: rdata = rise;
+        REG_FALL: rdata = fall;
+        default: rdata = {1'b1, {(31 - 2*N){1'b0}}, fall_mask, rise_mask};
+    endcase
+end
+
+always @(posedge clk) begin
+    sync_a <= switches;
+    sync_b <= sync_a;
+    prescale <= prescale + 1'b1;
+    state <= state ^ flip;
+
+    if (reset) begin
+        rise <= {N{1'b0}};
+        fall <= {N{1'b0}};
+        rise_mask <= {N{1'b1}};
+        fall_mask <= {N{1'b0}};
+    end else begin
+        rise <= (rise & ~({N{wstrb & (reg_addr == REG_RISE)}} & wdata[N-1:0])) | new_rise;
+        fall <= (fall & ~({N{wstrb & (reg_addr == REG_FALL)}} & wdata[N-1:0])) | new_fall;
+        if (wstrb & (reg_addr == REG_CTRL))
+            {fall_mask, rise_mask} <= wdata[2*N-1:0];
+    end
+end
+
+endmodule
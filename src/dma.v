@@ -0,0 +1,193 @@
+`default_nettype none
+
+// Block copies to RAM, from flash or RAM, while the core runs on.
+// Flash is read in bursts of up to 16 words; each word is written to RAM
+// as it arrives, ahead of the core (the core's RAM access waits a cycle
+// on mem_ready). RAM to RAM copies read in cycles the core leaves the RAM
+// port free and write on the next one, 2 cycles a word at best.
+//
+// OLED mode streams flash to the PMOD OLED instead: SRC is read as a
+// flash address one word at a time (the READ stays open) and each word is
+// shifted out MSB first on SCK / MOSI, SCK at clk / (2 * SCK_HALF), while
+// system.v holds CS# low and DC high. SWAP16 sends each halfword high
+// byte first (RGB565 pixels), else the bytes go out in memory order.
+//
+// Registers: 0 SRC, 1 DST (byte addresses, word aligned), 2 LEN (bytes,
+// rounded up to words, at most 65535, counts down while busy), 3 CTRL:
+// write bit 0 to start, with the mode in bits 2-3, bit 1 to clear done;
+// reads {present, ..., swap16, oled, done, busy}. SRC, DST and LEN advance with the copy
+// and ignore writes while busy.
+module dma #(
+  parameter SCK_HALF = 2 // clk cycles per SCK phase: 6.25 MHz, the SSD1331 takes 6.6
+) (
+  input clk,
+  input reset,
+
+  // Registers
+  input wstrb,
+  input [1:0] reg_addr,
+  input [31:0] wdata,
+  output reg [31:0] rdata,
+  output finished,         // one cycle when a copy is done
+
+  // Flash reads, through flash_arbiter
+  output flash_req,
+  output [20:0] flash_address,   // in the flash bus window, system.v maps it
+  output [3:0] flash_burst,
+  input flash_grant,
+  input flash_rword,
+  input [31:0] flash_rdata,
+
+  // Data port of memory.v
+  input ram_free,          // the core does not use the RAM this cycle
+  output ram_rstrb,
+  output ram_wstrb,
+  output [31:0] ram_addr,
+  output [31:0] ram_wdata,
+  input [31:0] ram_rdata,
+
+  // OLED SPI, in place of the PMOD register bits while oled_active
+  output oled_active,
+  output reg oled_sck,
+  output oled_mosi
+);
+
+localparam REG_SRC = 0;
+localparam REG_DST = 1;
+localparam REG_LEN = 2;
+localparam REG_CTRL = 3;
+
+localparam CTRL_START = 0;
+localparam CTRL_DONE = 1;
+localparam CTRL_OLED = 2;
+localparam CTRL_SWAP16 = 3;
+
+reg [23:2] src;
+reg [23:2] dst;
+reg [14:0] len;          // in words, up to 16384 (64 KB)
+reg busy = 1'b0;
+reg done = 1'b0;
+reg oled = 1'b0;
+reg swap16 = 1'b0;
+
+reg in_burst = 1'b0;     // words of a flash burst are on their way
+reg [3:0] burst_left;
+reg ram_read_q = 1'b0;   // RAM word read last cycle, write it now
+
+// OLED: the next word, and the one being shifted out
+reg [31:0] hold;
+reg hold_valid = 1'b0;
+reg [31:0] shift;
+reg [5:0] bits = 6'd0;   // still to shift out
+reg [3:0] phase;
+
+initial oled_sck = 1'b0;
+
+wire from_flash = src[23] | oled;
+wire flash_word = in_burst & flash_rword;
+
+assign flash_req = busy & from_flash & ~in_burst & (len != 0) & ~(oled & hold_valid);
+assign flash_address = src[22:2];
+assign flash_burst = oled ? 4'd0 : (len > 16) ? 4'd15 : len[3:0] - 4'd1;
+
+assign ram_rstrb = busy & ~from_flash & (len != 0) & ~ram_read_q & ram_free;
+assign ram_wstrb = (flash_word & ~oled) | ram_read_q;
+assign ram_addr = {8'b0, ram_wstrb ? dst : src, 2'b00};
+assign ram_wdata = from_flash ? flash_rdata : ram_rdata;
+
+assign oled_active = busy & oled;
+assign oled_mosi = shift[31];
+
+wire copied = ram_wstrb | (flash_word & oled);
+assign finished = busy & (len == 0) & ~hold_valid & (bits == 0);
+
+wire start = wstrb & (reg_addr == REG_CTRL) & wdata[CTRL_START] & ~busy;
+
+always @(*) begin
+    case (reg_addr)
+        REG_SRC: rdata = {8'b0, src, 2'b00};
+        REG_DST: rdata = {8'b0, dst, 2'b00};
+        REG_LEN: rdata = {15'b0, len, 2'b00};
+        default: rdata = {1'b1, 27'b0, swap16, oled, done, busy};
+    endcase
+end
+
+always @(posedge clk) begin
+    if (reset) begin
+        busy <= 1'b0;
+        done <= 1'b0;
+        oled <= 1'b0;
+        in_burst <= 1'b0;
+        ram_read_q <= 1'b0;
+        hold_valid <= 1'b0;
+        bits <= 6'd0;
+        oled_sck <= 1'b0;
+    end else begin
+        if (wstrb & ~busy) begin
+            if (reg_addr == REG_SRC) src <= wdata[23:2];
+            if (reg_addr == REG_DST) dst <= wdata[23:2];
+            if (reg_addr == REG_LEN) len <= ({1'b0, wdata[15:0]} + 17'd3) >> 2; // 15 bits, no wrap
+        end
+
+        if (start) begin
+            busy <= 1'b1;
+            done <= 1'b0;
+            oled <= wdata[CTRL_OLED];
+            swap16 <= wdata[CTRL_SWAP16];
+        end else if (wstrb & (reg_addr == REG_CTRL) & wdata[CTRL_DONE]) begin
+            done <= 1'b0;
+        end
+
+        if (finished) begin
+            busy <= 1'b0;
+            done <= 1'b1;
+        end
+
+        if (flash_grant) begin
+            in_burst <= 1'b1;
+            burst_left <= flash_burst;
+        end
+
+        if (flash_word) begin
+            burst_left <= burst_left - 4'd1;
+            if (burst_left == 0) in_burst <= 1'b0;
+        end
+
+        ram_read_q <= ram_rstrb;
+        if (ram_rstrb | flash_word) src <= src + 1'b1;
+
+        if (copied) begin
+            dst <= dst + 1'b1;
+            len <= len - 1'b1;
+        end
+
+        // OLED: catch the word from flash while the previous one shifts out
+        if (flash_word & oled) begin
+            hold <= swap16 ?
+                {flash_rdata[15:8], flash_rdata[7:0], flash_rdata[31:24], flash_rdata[23:16]} :
+                {flash_rdata[7:0], flash_rdata[15:8], flash_rdata[23:16], flash_rdata[31:24]};
+            hold_valid <= 1'b1;
+        end
+
+        if (bits == 0) begin
+            if (hold_valid) begin
+                shift <= hold;
+                bits <= 6'd32;
+                hold_valid <= 1'b0;
+                phase <= 0;
+            end
+        end else if (phase == SCK_HALF - 1) begin
+            // MOSI moves on the falling edge, the OLED samples on the rising one
+            phase <= 0;
+            oled_sck <= ~oled_sck;
+            if (oled_sck) begin
+                shift <= {shift[30:0], 1'b0};
+                bits <= bits - 6'd1;
+            end
+        end else begin
+            phase <= phase + 1'b1;
+        end
+    end
+end
+
+endmodule
@@ -0,0 +1,116 @@
+`default_nettype none
+
+// Shares spi_flash between the instruction and the data bus. A read
+// strobe goes straight through when the flash is idle, otherwise it waits
+// here; the data bus goes first. Both buses get the same rdata, so a bus
+// must use its word before the other one's read completes (riscv_32i
+// consumes a load before the instruction fetched alongside it). The words
+// of a burst (cache line fills) go to the bus that asked, with rword.
+// Flash commands (program / erase) and then the DMA port come last: they
+// hold their request until granted and are never queued here.
+module flash_arbiter (
+    input  wire        clk,
+
+    input  wire        i_rstrb,
+    input  wire [21:0] i_word_address,
+    input  wire [3:0]  i_burst,
+    output wire        i_rbusy,
+    output wire        i_rword,
+
+    input  wire        d_rstrb,
+    input  wire [21:0] d_word_address,
+    input  wire [3:0]  d_burst,
+    output wire        d_rbusy,
+    output wire        d_rword,
+
+    input  wire        x_req,
+    input  wire [21:0] x_word_address,
+    input  wire [3:0]  x_burst,
+    output wire        x_grant,
+    output wire        x_rword,
+
+    input  wire        c_req,
+    output wire        c_grant,
+    output wire        c_rbusy,
+
+    output wire        busy,            // a read is queued or in progress
+
+    // spi_flash
+    output wire        rstrb,
+    output wire        cmd,             // the strobe is c_grant
+    output wire [21:0] word_address,
+    output wire [3:0]  burst,
+    input  wire        rbusy,
+    input  wire        rword
+);
+
+reg i_pending = 1'b0;
+reg d_pending = 1'b0;
+reg [21:0] i_address_q;
+reg [3:0] i_burst_q;
+reg [21:0] d_address_q;
+reg [3:0] d_burst_q;
+reg served_d = 1'b0;
+reg served_x = 1'b0;
+reg served_c = 1'b0;
+
+wire idle = ~rbusy & ~i_pending & ~d_pending;
+
+wire pass_d  = d_rstrb & idle;
+wire pass_i  = i_rstrb & idle & ~d_rstrb;
+wire issue_d = d_pending & ~rbusy;
+wire issue_i = i_pending & ~d_pending & ~rbusy;
+
+assign c_grant = c_req & idle & ~d_rstrb & ~i_rstrb;
+assign x_grant = x_req & idle & ~d_rstrb & ~i_rstrb & ~c_req;
+
+assign rstrb = pass_d | pass_i | issue_d | issue_i | c_grant | x_grant;
+assign cmd = c_grant;
+assign word_address =
+    pass_d  ? d_word_address :
+    pass_i  ? i_word_address :
+    issue_d ? d_address_q :
+    issue_i ? i_address_q :
+    x_word_address;
+assign burst =
+    pass_d  ? d_burst :
+    pass_i  ? i_burst :
+    issue_d ? d_burst_q :
+    issue_i ? i_burst_q :
+    x_burst;
+
+wire served_i = ~served_d & ~served_x & ~served_c;
+
+assign d_rbusy = d_pending | (served_d & rbusy);
+assign i_rbusy = i_pending | (served_i & rbusy);
+assign i_rword = served_i & rword;
+assign d_rword = served_d & rword;
+assign x_rword = served_x & rword;
+assign c_rbusy = served_c & rbusy;
+assign busy = rbusy | i_pending | d_pending;
+
+always @(posedge clk) begin
+    if (d_rstrb & ~pass_d) begin
+        d_pending <= 1'b1;
+        d_address_q <= d_word_address;
+        d_burst_q <= d_burst;
+    end else if (issue_d) begin
+        d_pending <= 1'b0;
+    end
+
+    if (i_rstrb & ~pass_i) begin
+        i_pending <= 1'b1;
+        i_address_q <= i_word_address;
+        i_burst_q <= i_burst;
+    end else if (issue_i) begin
+        i_pending <= 1'b0;
+    end
+
+    if (rstrb) begin
+        served_d <= pass_d | issue_d;
+        served_x <= x_grant;
+        served_c <= c_grant;
+    end
+end
+
+endmodule
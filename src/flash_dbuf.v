@@ -0,0 +1,128 @@
+`default_nettype none
+
+// Read buffer for data loads from flash: two lines of 2^LINE_BITS words in
+// flip-flops. A load of a buffered word answers on the next cycle, like
+// RAM. A miss reads from the missed word to the end of its line in one
+// flash burst. Once a load moves on to the line after the previous one,
+// the line after that is prefetched into the other buffer while the
+// current one is used.
+module flash_dbuf #(
+  parameter LINE_BITS = 2 // 4 words per line
+) (
+  input clk,
+
+  // Data port
+  input rstrb,
+  input [21:0] word_address,
+  output reg [31:0] rdata,
+  output rbusy,
+  output busy,            // a load, fill or prefetch is outstanding
+
+  // Line fills, through flash_arbiter
+  output fill_rstrb,
+  output [21:0] fill_address,
+  output [3:0] fill_burst,
+  input fill_rword,
+  input [31:0] fill_rdata,
+  input flush             // flash was programmed or erased
+);
+
+localparam LINE_WORDS = 1 << LINE_BITS;
+localparam TAG_BITS = 22 - LINE_BITS;
+
+reg [31:0] words [2*LINE_WORDS];
+reg [TAG_BITS-1:0] tag0, tag1;
+reg [2*LINE_WORDS-1:0] valid = 0; // {buffer, word}
+reg cur = 1'b0;                    // buffer of the last load
+reg [TAG_BITS-1:0] last_line;
+
+reg pending = 1'b0;                // load of address_q not answered yet
+reg [21:0] address_q;
+
+reg filling = 1'b0;
+reg fill_buf;
+reg [TAG_BITS-1:0] fill_line;
+reg [LINE_BITS-1:0] fill_word;     // next word the burst delivers
+
+reg prefetch = 1'b0;               // prefetch_line waits for the fill engine
+reg [TAG_BITS-1:0] prefetch_line;
+
+// Lookup of the new load, or of the one waiting
+wire [21:0] lookup_address = pending ? address_q : word_address;
+wire [TAG_BITS-1:0] line = lookup_address[21:LINE_BITS];
+wire [LINE_BITS-1:0] word = lookup_address[LINE_BITS-1:0];
+wire lookup = rstrb | pending;
+
+wire match0 = (tag0 == line) & (|valid[0 +: LINE_WORDS]);
+wire match1 = (tag1 == line) & (|valid[LINE_WORDS +: LINE_WORDS]);
+wire hit0 = match0 & valid[{1'b0, word}];
+wire hit1 = match1 & valid[{1'b1, word}];
+wire hit = lookup & (hit0 | hit1);
+wire hit_buf = hit1;
+
+// The word is on its way in the running burst
+wire coming = filling & (fill_line == line) & (fill_word <= word);
+
+// Fill from the missed word on, into the buffer already holding part of
+// the line, or else into the one not used last
+wire demand = lookup & ~hit & ~coming & ~filling;
+wire demand_buf = match1 | (~match0 & ~cur);
+wire start_prefetch = prefetch & ~filling & ~(lookup & ~hit);
+
+wire [TAG_BITS-1:0] next_line = line + 1'b1;
+wire next_present = (hit_buf ? tag0 : tag1) == next_line;
+
+assign fill_rstrb = demand | start_prefetch;
+assign fill_address = demand ? lookup_address : {prefetch_line, {LINE_BITS{1'b0}}};
+assign fill_burst = demand ? LINE_WORDS - 1 - word : LINE_WORDS - 1;
+
+assign rbusy = pending;
+assign busy = pending | filling | prefetch;
+
+always @(posedge clk) begin
+    if (rstrb) address_q <= word_address;
+    if (start_prefetch | (demand & line == prefetch_line)) prefetch <= 1'b0;
+
+    if (hit) begin
+        rdata <= words[{hit_buf, word}];
+        pending <= 1'b0;
+        cur <= hit_buf;
+        last_line <= line;
+
+        // Streaming: fetch the line after this one into the other buffer
+        if (line == last_line + 1'b1 && !next_present) begin
+            prefetch <= 1'b1;
+            prefetch_line <= next_line;
+        end
+    end else if (rstrb) begin
+        pending <= 1'b1;
+    end
+
+    if (fill_rstrb) begin
+        filling <= 1'b1;
+        fill_buf <= demand ? demand_buf : ~cur;
+        fill_line <= demand ? line : prefetch_line;
+        fill_word <= demand ? word : 0;
+    end
+
+    if (demand & ~(match0 | match1)) begin
+        if (demand_buf) tag1 <= line; else tag0 <= line;
+        valid[{demand_buf, {LINE_BITS{1'b0}}} +: LINE_WORDS] <= 0;
+    end else if (start_prefetch) begin
+        if (cur) tag0 <= prefetch_line; else tag1 <= prefetch_line;
+        valid[{~cur, {LINE_BITS{1'b0}}} +: LINE_WORDS] <= 0;
+    end
+
+    if (filling & fill_rword) begin
+        words[{fill_buf, fill_word}] <= fill_rdata;
+        valid[{fill_buf, fill_word}] <= 1'b1;
+        fill_word <= fill_word + 1'b1;
+        if (fill_word == LINE_WORDS - 1)
+            filling <= 1'b0;
+    end
+
+    if (flush)
+        valid <= 0;
+end
+
+endmodule
@@ -0,0 +1,111 @@
+`default_nettype none
+
+// Direct-mapped instruction cache in front of flash: 256 words (two
+// BRAMs, the tags a third) in lines of 2^LINE_BITS words. A read is looked up on the cycle
+// after rstrb, like a RAM read; a miss reads the whole line in one flash
+// burst and returns the word once the line is in. The lines stay valid
+// across SW1; flush (a flash program or erase) drops them all.
+module icache #(
+  parameter LINE_BITS = 3 // 8 words per line, 32 lines
+) (
+  input clk,
+
+  // Instruction port
+  input rstrb,
+  input [21:0] word_address,
+  output [31:0] rdata,
+  output rbusy,
+  output busy,            // lookup or line fill in progress
+
+  // Line fills, through flash_arbiter
+  output fill_rstrb,
+  output [21:0] fill_address,
+  output [3:0] fill_burst,
+  input fill_rword,
+  input [31:0] fill_rdata,
+  input flush,
+
+  // Hit / miss counters
+  input clear,
+  output reg [31:0] hits,
+  output reg [31:0] misses
+);
+
+localparam LINE_WORDS = 1 << LINE_BITS;
+localparam INDEX_BITS = 8 - LINE_BITS;
+localparam LINES = 1 << INDEX_BITS;
+localparam TAG_BITS = 22 - 8;
+
+reg [31:0] data [256];
+reg [TAG_BITS-1:0] tags [LINES];
+reg [LINES-1:0] valid = 0;     // in flip-flops, for flush
+
+initial begin
+    hits = 0;
+    misses = 0;
+end
+
+reg [21:0] address_q;
+reg [31:0] data_q;
+reg [TAG_BITS-1:0] tag_q;
+reg valid_q;
+reg lookup = 1'b0;       // tag_q / data_q belong to address_q
+reg filling = 1'b0;
+reg [LINE_BITS-1:0] fill_count;
+reg [31:0] word_q;       // the missed word, caught during the fill
+reg from_fill = 1'b0;    // rdata is word_q
+
+wire [INDEX_BITS-1:0] index = address_q[7:LINE_BITS];
+wire hit = lookup & valid_q & (tag_q == address_q[21:8]);
+wire miss = lookup & ~hit;
+
+assign rdata = from_fill ? word_q : data_q;
+assign rbusy = miss | filling;
+assign busy = lookup | filling;
+
+assign fill_rstrb = miss;
+assign fill_address = {address_q[21:LINE_BITS], {LINE_BITS{1'b0}}};
+assign fill_burst = LINE_WORDS - 1;
+
+always @(posedge clk) begin
+    if (rstrb) begin
+        address_q <= word_address;
+        data_q <= data[word_address[7:0]];
+        tag_q <= tags[word_address[7:LINE_BITS]];
+        valid_q <= valid[word_address[7:LINE_BITS]];
+        from_fill <= 1'b0;
+    end
+    lookup <= rstrb;
+
+    if (miss) begin
+        filling <= 1'b1;
+        fill_count <= 0;
+    end
+
+    if (filling & fill_rword) begin
+        data[{index, fill_count}] <= fill_rdata;
+        if (fill_count == address_q[LINE_BITS-1:0])
+            word_q <= fill_rdata;
+
+        fill_count <= fill_count + 1'b1;
+        if (fill_count == LINE_WORDS - 1) begin
+            tags[index] <= address_q[21:8];
+            valid[index] <= 1'b1;
+            filling <= 1'b0;
+            from_fill <= 1'b1;
+        end
+    end
+
+    if (flush)
+        valid <= 0;
+
+    if (clear) begin
+        hits <= 0;
+        misses <= 0;
+    end else begin
+        hits <= hits + hit;
+        misses <= misses + miss;
+    end
+end
+
+endmodule
@@ -1,26 +1,81 @@
 `default_nettype none
 
-module memory (
+// RAM with an instruction read port and a data read/write port.
+// iCE40 BRAMs have one read port each, so the RAM is built from banks of
+// 256 words (two BRAMs): reads of different banks happen in the same cycle,
+// an instruction read of the bank the data port reads waits one cycle
+// (i_rbusy). Read data is valid until the bank is read again.
+module memory #(
+  parameter BANKS = 6 // of 256 words, 6 KB
+) (
   input clk,
+
+  // Instruction port
+  input i_rstrb,
+  input [31:0] i_addr,
+  output [31:0] i_rdata,
+  output i_rbusy,
+
+  // Data port
   input mem_rstrb,
   input [31:0] mem_addr,
   input [31:0] mem_wdata,
   input [3:0] mem_wmask,
-  output reg [31:0] mem_rdata
+  output [31:0] mem_rdata
 );
 
-reg [31:0] mem [1536];
+wire [10:0] d_word_addr = mem_addr[12:2];
+wire [10:0] i_word_addr = i_pending ? i_word_addr_q : i_addr[12:2];
+
+wire [2:0] d_bank = d_word_addr[10:8];
+wire [2:0] i_bank = i_word_addr[10:8];
+
+reg i_pending;
+reg [10:0] i_word_addr_q;
+
+wire i_conflict = mem_rstrb & (d_bank == i_bank);
+wire i_read = (i_rstrb | i_pending) & ~i_conflict;
+
+reg [2:0] d_bank_q, i_bank_q;
+wire [32*BANKS-1:0] bank_rdata;
 
-wire [10:0] word_addr = mem_addr[12:2];
 always @(posedge clk) begin
-  if (mem_rstrb) begin
-      mem_rdata <= mem[word_addr];
+  if (mem_rstrb) d_bank_q <= d_bank;
+  if (i_read) i_bank_q <= i_bank;
+
+  if (i_rstrb) i_word_addr_q <= i_addr[12:2];
+  i_pending <= (i_rstrb | i_pending) & i_conflict;
+end
+
+assign i_rbusy = i_pending;
+assign mem_rdata = bank_rdata[32*d_bank_q +: 32];
+assign i_rdata = bank_rdata[32*i_bank_q +: 32];
+
+genvar b;
+generate
+for (b = 0; b < BANKS; b = b + 1) begin : bank
+  reg [31:0] mem [256];
+  reg [31:0] rdata;
+
+  wire d_sel = mem_rstrb & (d_bank == b);
+  wire i_sel = i_read & (i_bank == b);
+  wire [3:0] wmask = (d_bank == b) ? mem_wmask : 4'b0000;
+  wire [7:0] w = d_word_addr[7:0];
+
+  always @(posedge clk) begin
+    if (d_sel)
+        rdata <= mem[w];
+    else if (i_sel)
+        rdata <= mem[i_word_addr[7:0]];
+
+    if(wmask[0]) mem[w][7:0] <= mem_wdata[7:0];
+    if(wmask[1]) mem[w][15:8] <= mem_wdata[15:8];
+    if(wmask[2]) mem[w][23:16] <= mem_wdata[23:16];
+    if(wmask[3]) mem[w][31:24] <= mem_wdata[31:24];
   end
 
-  if(mem_wmask[0]) mem[word_addr][7:0] <= mem_wdata[7:0];
-  if(mem_wmask[1]) mem[word_addr][15:8] <= mem_wdata[15:8];
-  if(mem_wmask[2]) mem[word_addr][23:16] <= mem_wdata[23:16];
-  if(mem_wmask[3]) mem[word_addr][31:24] <= mem_wdata[31:24];
+  assign bank_rdata[32*b +: 32] = rdata;
 end
+endgenerate
 
 endmodule
@@ -0,0 +1,49 @@
+`default_nettype none
+
+// Random numbers for the path tracer: a 64-bit xorshift (13, 7, 17) that
+// steps every cycle, so each read of VALUE sees a new number. VALUE is the
+// xor of both state halves. The sequence restarts from a fixed seed at
+// reset, so a render is repeatable; writing SEED restarts it from
+// {SEED, SEED_LOW}, never the all-zero state.
+//
+// Registers: 0 VALUE (read), 1 SEED (write; reads {present, 0}).
+module prng (
+  input clk,
+  input reset,
+
+  // Registers
+  input wstrb,
+  input reg_addr,
+  input [31:0] wdata,
+  output reg [31:0] rdata
+);
+
+localparam REG_VALUE = 0;
+localparam REG_SEED = 1;
+
+localparam [31:0] SEED_LOW = 32'h9E3779B9;
+localparam [63:0] SEED_RESET = {32'h2545F491, SEED_LOW};
+
+reg [63:0] state = SEED_RESET;
+
+wire [63:0] s1 = state ^ (state << 13);
+wire [63:0] s2 = s1 ^ (s1 >> 7);
+wire [63:0] next = s2 ^ (s2 << 17);
+
+always @(*) begin
+    case (reg_addr)
+        REG_VALUE: rdata = state[63:32] ^ state[31:0];
+        default: rdata = {1'b1, 31'b0};
+    endcase
+end
+
+always @(posedge clk) begin
+    if (reset)
+        state <= SEED_RESET;
+    else if (wstrb & (reg_addr == REG_SEED))
+        state <= {wdata, SEED_LOW};
+    else
+        state <= next;
+end
+
+endmodule
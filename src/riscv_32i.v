@@ -1,11 +1,33 @@
 `default_nettype none
 
-module riscv_32i (
+module riscv_32i #(
+  parameter RV32M = 1, // multiply / divide extension
+  parameter FXP   = 1, // custom-0 Q16.16 mul / div / sqrt / rsqrt (needs RV32M)
+  parameter RV32C = 1, // compressed instructions
+  parameter ZBB   = 1, // basic bit manipulation
+  parameter ZICSR = 1, // CSR instructions, cycle / instret counters
+  parameter MTRAP = 1, // machine mode traps and interrupts (needs ZICSR)
+  parameter HARTS = 1, // 2..4: switch to another hart while one waits on flash
+  parameter ICACHE = 0 // flash fetches go through an instruction cache
+) (
   input clk, reset,
+  input irq, // external interrupt request (mip.MEIP), level sensitive
+  input flash_busy, // flash transfer in progress, whoever strobed it (HARTS > 1)
+
+  // Instruction bus
+  input [31:0] imem_rdata,
+  input imem_rbusy,
+  output [31:0] imem_addr,
+  output imem_rstrb,
+
+  // Data bus: a request (a store when mem_wmask != 0) is taken when
+  // mem_ready is high, read data comes later with mem_rvalid. Stores are
+  // posted, the core does not wait for them to complete.
   input [31:0] mem_rdata,
-  input mem_rbusy,
+  input mem_ready,
+  input mem_rvalid,
   output [31:0] mem_addr,
-  output mem_rstrb,
+  output mem_req,
   output [31:0] mem_wdata,
   output [3:0] mem_wmask
 );
@@ -13,6 +35,7 @@ module riscv_32i (
 localparam RESET_ADDR = 32'h00810000;
 localparam ADDR_WIDTH = 24;
 localparam ADDR_PAD = 32 - ADDR_WIDTH;
+localparam SLOW_ADDR_BIT = 23; // flash
 
 wire is_alu_reg = (instr[6:2] == 5'b01100); // reg <= reg op reg
 wire is_alu_imm = (instr[6:2] == 5'b00100); // reg <= reg op imm
@@ -21,10 +44,23 @@ wire is_jalr    = (instr[6:2] == 5'b11001); // reg <= pc + 4 ; pc <= reg + imm
 wire is_jal     = (instr[6:2] == 5'b11011); // reg <= pc + 4 ; pc <= pc + imm
 wire is_auipc   = (instr[6:2] == 5'b00101); // reg <= pc + (imm << 12)
 wire is_lui     = (instr[6:2] == 5'b01101); // reg <= (imm << 12)
-wire is_load    = (instr[6:2] == 5'b00000); // reg <= mem[reg + imm]
+wire is_load    = (instr[6:2] == 5'b00000) & ~is_illegal; // reg <= mem[reg + imm]
 wire is_store   = (instr[6:2] == 5'b01000); // mem[reg + imm] <= reg
 wire is_system  = (instr[6:2] == 5'b11100); // ...
-wire is_alu = is_alu_reg | is_alu_imm;
+wire is_muldiv  = RV32M && is_alu_reg && (instr[31:25] == 7'b0000001); // reg <= reg (*|/|%) reg
+wire is_fxp     = FXP && (instr[6:2] == 5'b00010); // reg <= reg fxp_op reg
+wire is_md      = is_muldiv | is_fxp; // runs in the multiply / divide unit
+wire is_csr     = ZICSR && is_system && (instr[14:12] != 3'b000); // reg <= csr op= reg
+wire is_priv    = is_system & ~is_csr; // ecall / ebreak / mret / wfi
+wire is_ecall   = is_priv & (instr[31:20] == 12'h000);
+wire is_ebreak  = is_priv & (instr[31:20] == 12'h001);
+wire is_mret    = MTRAP && is_priv && (instr[31:20] == 12'h302);
+wire is_wfi     = MTRAP && is_priv && (instr[31:20] == 12'h105);
+wire is_halt    = !MTRAP && (is_ecall || is_ebreak); // no traps: pc stays put
+// A reserved compressed encoding, which rvc_expand turns into 0. Without
+// traps it runs as a load of x0.
+wire is_illegal = MTRAP && instr_c && (instr[31:2] == 30'b0);
+wire is_alu = (is_alu_reg & ~is_muldiv) | is_alu_imm;
 
 wire [4:0] rs1_id = instr[19:15];
 wire [4:0] rs2_id = instr[24:20];
@@ -40,13 +76,13 @@ wire [31:0] imm_b = {{20{instr[31]}}, instr[7], instr[30:25], instr[11:8], 1'b0}
 wire [31:0] imm_j = {{12{instr[31]}}, instr[19:12], instr[20], instr[30:21], 1'b0};
 
 (* no_rw_check *)
-reg [31:0] registers [32];
+reg [31:0] registers [32 * HARTS];
 reg [31:0] rs1, rs2;
 
 
 always @(posedge clk) begin
     if (write_back && rd_id != 0) begin
-        registers[rd_id] <= write_back_data;
+        registers[{hart, rd_id}] <= write_back_data;
     end
 end
 
@@ -71,8 +107,11 @@ wire [31:0] shifter_in = funct3_is[1] ? {
     alu_a[28], alu_a[29], alu_a[30], alu_a[31]
 } : alu_a;
 
-wire signed [32:0] shifter_wide =
-    $signed({instr[30] & alu_a[31], shifter_in}) >>> alu_b[4:0];
+// Funnel shifter: rotates shift the input in again instead of sign / zero
+wire [63:0] shifter_wide = {
+    zbb_rotate ? shifter_in : {32{instr[30] & alu_a[31]}},
+    shifter_in
+} >> alu_b[4:0];
 
 wire [31:0] shifter = shifter_wide[31:0];
 
@@ -87,17 +126,425 @@ wire [31:0] left_shift = {
     shifter[28], shifter[29], shifter[30], shifter[31]
 };
 
-wire [31:0] alu_out = (
+wire [31:0] logic_b = zbb_invert ? ~alu_b : alu_b; // andn / orn / xnor
+
+wire [31:0] alu_base = (
     (funct3_is[0] ? (instr[30] & instr[5] ? alu_minus[31:0] : alu_plus) : 32'b0) |
     (funct3_is[1] ? left_shift                                          : 32'b0) |
     (funct3_is[2] ? {31'b0, LT}                                         : 32'b0) |
     (funct3_is[3] ? {31'b0, LTU}                                        : 32'b0) |
-    (funct3_is[4] ? alu_a ^ alu_b                                       : 32'b0) |
+    (funct3_is[4] ? alu_a ^ logic_b                                     : 32'b0) |
     (funct3_is[5] ? shifter                                             : 32'b0) |
-    (funct3_is[6] ? alu_a | alu_b                                       : 32'b0) |
-    (funct3_is[7] ? alu_a & alu_b                                       : 32'b0)
+    (funct3_is[6] ? alu_a | logic_b                                     : 32'b0) |
+    (funct3_is[7] ? alu_a & logic_b                                     : 32'b0)
+);
+
+wire [31:0] alu_out = zbb_other ? zbb_out : alu_base;
+
+/* ---------------- Zbb ---------------- */
+// andn / orn / xnor and the rotates go through the base ALU above, the
+// rest is decoded here. Immediate fields of the OP-IMM logic operations
+// overlap funct7, so those decodes are limited to register operations.
+wire zbb_op = ZBB && is_alu_reg;
+
+wire zbb_invert = zbb_op && instr[30] && (funct3_is[4] | funct3_is[6] | funct3_is[7]);
+wire zbb_rotate = ZBB && instr[29] && !instr[27] &&
+    (funct3_is[5] | (funct3_is[1] & is_alu_reg)); // ror, rori, rol
+wire zbb_minmax = zbb_op && instr[27] && instr[25] && instr[14]; // funct7 0000101
+wire zbb_zexth  = zbb_op && instr[27] && !instr[25] && funct3_is[4];
+wire zbb_unary  = ZBB && is_alu_imm && funct3_is[1] && instr[29]; // clz ... sext.h
+wire zbb_bytes  = ZBB && is_alu_imm && funct3_is[5] && instr[29] && instr[27]; // rev8, orc.b
+
+wire zbb_other = zbb_minmax | zbb_zexth | zbb_unary | zbb_bytes;
+
+// min / minu / max / maxu: funct3 bit 0 unsigned, bit 1 max
+wire zbb_lt = instr[12] ? LTU : LT;
+wire [31:0] zbb_minmax_out = (zbb_lt ^ instr[13]) ? alu_a : alu_b;
+
+// clz counts the trailing zeros of the bit reversed input (shifter_in),
+// ctz / clz count the ones of the trailing zeros mask ~x & (x - 1)
+wire [31:0] zbb_ctz_in = instr[20] ? alu_a : shifter_in;
+wire [31:0] zbb_pop_in = instr[21] ? alu_a : ~zbb_ctz_in & (zbb_ctz_in - 1);
+
+// Population count in 2, 4 then 8 bit fields
+wire [31:0] zbb_pop2 = zbb_pop_in - ((zbb_pop_in >> 1) & 32'h55555555);
+wire [31:0] zbb_pop4 = (zbb_pop2 & 32'h33333333) + ((zbb_pop2 >> 2) & 32'h33333333);
+wire [31:0] zbb_pop8 = (zbb_pop4 + (zbb_pop4 >> 4)) & 32'h0F0F0F0F;
+wire [5:0] zbb_pop = zbb_pop8[5:0] + zbb_pop8[13:8] + zbb_pop8[21:16] + zbb_pop8[29:24];
+
+wire [31:0] zbb_unary_out =
+    !instr[22] ? {26'b0, zbb_pop} :                       // clz, ctz, cpop
+    !instr[20] ? {{24{alu_a[7]}}, alu_a[7:0]} :           // sext.b
+    {{16{alu_a[15]}}, alu_a[15:0]};                       // sext.h
+
+wire [31:0] zbb_bytes_out = instr[30] ?
+    {alu_a[7:0], alu_a[15:8], alu_a[23:16], alu_a[31:24]} : // rev8
+    {{8{|alu_a[31:24]}}, {8{|alu_a[23:16]}},                // orc.b
+     {8{|alu_a[15:8]}}, {8{|alu_a[7:0]}}};
+
+wire [31:0] zbb_out = (
+    (zbb_minmax ? zbb_minmax_out         : 32'b0) |
+    (zbb_zexth  ? {16'b0, alu_a[15:0]}   : 32'b0) |
+    (zbb_unary  ? zbb_unary_out          : 32'b0) |
+    (zbb_bytes  ? zbb_bytes_out          : 32'b0)
 );
 
+/* ---------------- RV32M ---------------- */
+// One bit per cycle: shift-add multiply, restoring divide. Both share a
+// single 34-bit adder and the {md_hi, md_lo} shift register.
+//
+// The custom-0 Q16.16 instructions (FXP) reuse the same unit:
+//   funct3 0  fmul    (a * b) >> 16     signed multiply, middle word
+//   funct3 1  fdiv    (a << 16) / b     signed divide of a 48-bit dividend
+//   funct3 2  fsqrt   sqrt(a << 16)     two radicand bits per cycle, 24 cycles
+//   funct3 3  frsqrt  2^32 / fsqrt(a)   fsqrt, then a divide
+// fdiv is undefined when the quotient does not fit in 32 bits, fsqrt of a
+// negative value is 0.
+reg [31:0] md_hi, md_lo, md_b;
+reg [5:0] md_count;
+reg md_q_neg, md_r_neg;
+reg md_root_div; // frsqrt: the sqrt is done, dividing by it
+
+wire md_busy = (md_count != 0);
+
+wire fxp_mul   = is_fxp & funct3_is[0];
+wire fxp_div   = is_fxp & funct3_is[1];
+wire fxp_sqrt  = is_fxp & (funct3_is[2] | funct3_is[3]);
+wire fxp_rsqrt = is_fxp & funct3_is[3];
+
+wire md_is_sqrt = fxp_sqrt & ~md_root_div;
+wire md_is_div = is_fxp ? (fxp_div | md_root_div) : instr[14];
+wire md_signed_a = is_fxp ? fxp_mul : (funct3_is[1] | funct3_is[2]); // MULH, MULHSU
+wire md_signed_b = is_fxp ? fxp_mul : funct3_is[1];                  // MULH
+wire md_signed_div = is_fxp ? fxp_div : ~instr[12];                 // DIV, REM
+wire md_rem = ~is_fxp & instr[13];                                   // REM, REMU
+
+// Signed multiply: partial sums are sign extended and the last step
+// subtracts, as bit 31 of a signed multiplier weighs -2^31.
+wire md_hi_ext = md_signed_b & md_hi[31];
+wire md_b_ext = md_signed_b & md_b[31];
+wire md_sub = md_is_div | md_is_sqrt | (md_signed_a & (md_count == 1));
+
+// sqrt: md_hi is the remainder, md_lo the radicand, md_b the root
+wire [33:0] md_x =
+    md_is_sqrt ? {md_hi, md_lo[31:30]} :
+    md_is_div ? {1'b0, md_hi, md_lo[31]} :
+    {md_hi_ext, md_hi_ext, md_hi};
+wire [33:0] md_y =
+    md_is_sqrt ? {md_b, 2'b01} :
+    md_is_div ? {2'b0, md_b} :
+    {34{md_lo[0]}} & {md_b_ext, md_b_ext, md_b};
+wire [33:0] md_sum = md_x + (md_sub ? ~md_y : md_y) + {33'b0, md_sub};
+
+wire [31:0] md_abs_a = (md_signed_div & rs1[31]) ? -rs1 : rs1;
+wire [31:0] md_abs_b = (md_signed_div & rs2[31]) ? -rs2 : rs2;
+
+wire [31:0] md_div_out = md_rem ? md_hi : md_lo;
+wire md_div_neg = md_rem ? md_r_neg : md_q_neg;
+
+wire [31:0] md_out =
+    fxp_sqrt & ~fxp_rsqrt ? md_b :
+    md_is_div ? (md_div_neg ? -md_div_out : md_div_out) :
+    fxp_mul ? {md_hi[15:0], md_lo[31:16]} :
+    (funct3_is[0] ? md_lo : md_hi);
+
+always @(posedge clk) begin
+    if (reset) begin
+        md_count <= 0;
+    end else if (state[EXECUTE_BIT] & is_md) begin
+        md_hi <= fxp_div ? {16'b0, md_abs_a[31:16]} : 32'b0;
+        md_lo <= fxp_div ? {md_abs_a[15:0], 16'b0} :
+            fxp_sqrt ? (rs1[31] ? 32'b0 : rs1) :
+            md_is_div ? md_abs_a : rs1;
+        md_b <= fxp_sqrt ? 32'b0 : md_is_div ? md_abs_b : rs2;
+        md_q_neg <= md_signed_div & (rs1[31] ^ rs2[31]) & (rs2 != 0);
+        md_r_neg <= md_signed_div & rs1[31];
+        md_root_div <= 1'b0;
+        md_count <= fxp_rsqrt ? 56 : fxp_sqrt ? 24 : 32;
+    end else if (md_busy) begin
+        if (md_is_sqrt) begin
+            md_b <= {md_b[30:0], ~md_sum[33]};
+            if (fxp_rsqrt && md_count == 33) begin
+                // Last root bit: go on with 2^32 / root
+                md_hi <= 32'b1;
+                md_lo <= 32'b0;
+                md_root_div <= 1'b1;
+            end else begin
+                md_hi <= md_sum[33] ? md_x[31:0] : md_sum[31:0];
+                md_lo <= {md_lo[29:0], 2'b00};
+            end
+        end else if (md_is_div) begin
+            md_hi <= md_sum[33] ? md_x[31:0] : md_sum[31:0];
+            md_lo <= {md_lo[30:0], ~md_sum[33]};
+        end else begin
+            md_hi <= md_sum[32:1];
+            md_lo <= {md_sum[0], md_lo[31:1]};
+        end
+        md_count <= md_count - 1;
+    end
+end
+
+/* ---------------- Zicsr ---------------- */
+localparam CSR_MCYCLE    = 12'hB00;
+localparam CSR_MINSTRET  = 12'hB02;
+localparam CSR_MCYCLEH   = 12'hB80;
+localparam CSR_MINSTRETH = 12'hB82;
+localparam CSR_CYCLE     = 12'hC00;
+localparam CSR_INSTRET   = 12'hC02;
+localparam CSR_CYCLEH    = 12'hC80;
+localparam CSR_INSTRETH  = 12'hC82;
+localparam CSR_MHARTID   = 12'hF14;
+
+reg [63:0] mcycle;
+reg [63:0] minstret;
+
+wire [11:0] csr_id = instr[31:20];
+wire [31:0] csr_src = instr[14] ? {27'b0, instr[19:15]} : rs1; // csrr*i: zimm
+wire csr_is_rw = (instr[13:12] == 2'b01);
+
+// csrrs / csrrc with x0 (or zimm 0) only read
+wire csr_write = state[EXECUTE_BIT] & is_csr & (csr_is_rw | (instr[19:15] != 0));
+
+reg [31:0] csr_rdata;
+
+always @(*) begin
+    case (csr_id)
+        CSR_MCYCLE,    CSR_CYCLE:    csr_rdata = mcycle[31:0];
+        CSR_MCYCLEH,   CSR_CYCLEH:   csr_rdata = mcycle[63:32];
+        CSR_MINSTRET,  CSR_INSTRET:  csr_rdata = minstret[31:0];
+        CSR_MINSTRETH, CSR_INSTRETH: csr_rdata = minstret[63:32];
+        CSR_MHARTID:                 csr_rdata = {{(32-HART_BITS){1'b0}}, hart};
+        CSR_MHARTRUN:                csr_rdata = {{(32-HARTS){1'b0}}, hart_run};
+        default:                     csr_rdata = MTRAP ? trap_csr_rdata : 32'b0;
+    endcase
+end
+
+wire [31:0] csr_wdata = csr_is_rw ? csr_src :
+    instr[13] ? csr_rdata & ~csr_src : csr_rdata | csr_src;
+
+always @(posedge clk) begin
+    if (reset) begin
+        mcycle <= 0;
+        minstret <= 0;
+    end else begin
+        mcycle <= mcycle + 1;
+        if (state[EXECUTE_BIT] & ~is_stalled & ~trap_exception & ~park_load)
+            minstret <= minstret + 1;
+
+        if (csr_write) case (csr_id)
+            CSR_MCYCLE:    mcycle[31:0]    <= csr_wdata;
+            CSR_MCYCLEH:   mcycle[63:32]   <= csr_wdata;
+            CSR_MINSTRET:  minstret[31:0]  <= csr_wdata;
+            CSR_MINSTRETH: minstret[63:32] <= csr_wdata;
+            default: ;
+        endcase
+    end
+end
+
+/* ---------------- Traps ---------------- */
+// Machine mode only. ecall / ebreak and illegal (reserved compressed)
+// instructions trap from EXECUTE with mepc pointing at them; interrupts are taken between instructions, when the next fetch
+// starts, by fetching from mtvec instead. mtvec is direct mode only and
+// shared by all harts, the rest is kept per hart.
+localparam CSR_MSTATUS = 12'h300;
+localparam CSR_MIE     = 12'h304;
+localparam CSR_MTVEC   = 12'h305;
+localparam CSR_MEPC    = 12'h341;
+localparam CSR_MCAUSE  = 12'h342;
+localparam CSR_MIP     = 12'h344;
+
+localparam CAUSE_ILLEGAL    = 4'd2;
+localparam CAUSE_BREAKPOINT = 4'd3;
+localparam CAUSE_ECALL      = 4'd11; // ecall from M-mode
+localparam CAUSE_EXTERNAL   = 4'd11; // machine external interrupt
+
+reg [HARTS-1:0] hart_mstatus_mie, hart_mstatus_mpie;
+reg [HARTS-1:0] hart_mie_meie;
+reg [ADDR_WIDTH-1:2] mtvec;
+reg [ADDR_WIDTH-1:1] hart_mepc [HARTS];
+reg [4:0] hart_mcause [HARTS]; // {interrupt, code}
+
+wire mstatus_mie = hart_mstatus_mie[hart];
+wire mstatus_mpie = hart_mstatus_mpie[hart];
+wire mie_meie = hart_mie_meie[hart];
+wire [ADDR_WIDTH-1:1] mepc = hart_mepc[hart];
+wire [4:0] mcause = hart_mcause[hart];
+
+wire irq_pending = mie_meie & irq; // mip & mie, also wakes up wfi
+
+// wfi waits with pc on itself until an enabled interrupt is pending
+wire is_stalled = is_halt | (is_wfi & ~irq_pending);
+
+wire trap_exception = state[EXECUTE_BIT] & (is_ecall | is_ebreak | is_illegal);
+
+// Not right after a system instruction, so that clearing mstatus.MIE or
+// an mret takes effect before the next interrupt is considered.
+wire trap_irq = mstatus_mie & irq_pending & ~(state[EXECUTE_BIT] & is_system);
+
+wire trap = MTRAP && fetch_start && (trap_exception || trap_irq);
+
+reg [31:0] trap_csr_rdata;
+
+always @(*) begin
+    case (csr_id)
+        CSR_MSTATUS: trap_csr_rdata = {19'b0, 2'b11, 3'b0, mstatus_mpie, 3'b0, mstatus_mie, 3'b0};
+        CSR_MIE:     trap_csr_rdata = {20'b0, mie_meie, 11'b0};
+        CSR_MIP:     trap_csr_rdata = {20'b0, irq, 11'b0};
+        CSR_MTVEC:   trap_csr_rdata = {{ADDR_PAD{1'b0}}, mtvec, 2'b00};
+        CSR_MEPC:    trap_csr_rdata = {{ADDR_PAD{1'b0}}, mepc, 1'b0};
+        CSR_MCAUSE:  trap_csr_rdata = {mcause[4], 27'b0, mcause[3:0]};
+        default:     trap_csr_rdata = 32'b0;
+    endcase
+end
+
+always @(posedge clk) begin
+    if (reset) begin
+        hart_mstatus_mie <= {HARTS{1'b0}};
+        hart_mstatus_mpie <= {HARTS{1'b0}};
+        hart_mie_meie <= {HARTS{1'b0}};
+        mtvec <= RESET_ADDR[ADDR_WIDTH-1:2];
+    end else if (trap) begin
+        hart_mepc[hart] <= trap_exception ? pc[ADDR_WIDTH-1:1] : seq_pc[ADDR_WIDTH-1:1];
+        hart_mcause[hart] <= ~trap_exception ? {1'b1, CAUSE_EXTERNAL} :
+            {1'b0, is_illegal ? CAUSE_ILLEGAL : is_ebreak ? CAUSE_BREAKPOINT : CAUSE_ECALL};
+        hart_mstatus_mpie[hart] <= mstatus_mie;
+        hart_mstatus_mie[hart] <= 1'b0;
+    end else if (state[EXECUTE_BIT] & is_mret) begin
+        hart_mstatus_mie[hart] <= mstatus_mpie;
+        hart_mstatus_mpie[hart] <= 1'b1;
+    end else if (MTRAP && csr_write) begin
+        case (csr_id)
+            CSR_MSTATUS: begin
+                hart_mstatus_mie[hart] <= csr_wdata[3];
+                hart_mstatus_mpie[hart] <= csr_wdata[7];
+            end
+            CSR_MIE:    hart_mie_meie[hart] <= csr_wdata[11];
+            CSR_MTVEC:  mtvec <= csr_wdata[ADDR_WIDTH-1:2];
+            CSR_MEPC:   hart_mepc[hart] <= csr_wdata[ADDR_WIDTH-1:1];
+            CSR_MCAUSE: hart_mcause[hart] <= {csr_wdata[31], csr_wdata[3:0]};
+            default: ;
+        endcase
+    end
+end
+
+/* ---------------- Harts ---------------- */
+// With HARTS > 1 the core switches harts instead of waiting on flash.
+// A hart whose fetch or load misses in flash starts the transfer and parks;
+// once flash is idle it is resumed and replays the access, which the flash
+// answers from the word it still holds (the hart owns that word until the
+// replay). A load is replayed from its saved instruction, a fetch from its
+// pc together with a buffered lower half. Other harts wanting flash in the
+// meantime park without strobing. wfi and a cleared mhartrun bit park too.
+// Registers live in one BRAM, banked by hart.
+localparam BARREL = (HARTS > 1);
+localparam HART_BITS = (HARTS > 2) ? 2 : 1;
+localparam CSR_MHARTRUN = 12'h7C0; // custom: harts allowed to run
+
+reg [HART_BITS-1:0] hart;
+reg [HARTS-1:0] hart_run;
+
+// Context of the harts that are not running
+reg [ADDR_WIDTH-1:0] hart_pc [HARTS];
+reg [31:2] hart_instr [HARTS]; // parked load, or [17:2]: fetch_buf
+reg [HARTS-1:0] hart_instr_c;
+reg [HARTS-1:0] hart_decode;    // resume with the saved load
+reg [HARTS-1:0] hart_buf_valid; // fetch_buf holds the half at hart_pc
+reg [HARTS-1:0] hart_wait;      // waiting for flash
+reg [HARTS-1:0] hart_sleep;     // in wfi
+
+reg flash_resv; // flash holds the word read for flash_owner
+reg [HART_BITS-1:0] flash_owner;
+
+// flash_busy gathers the arbiter and both flash caches: registered, so
+// the strobe decision stays off those paths
+reg flash_busy_q;
+
+wire flash_held = flash_resv & hart_run[flash_owner];
+wire flash_mine = flash_resv & (flash_owner == hart);
+wire flash_blocked = flash_busy_q | (flash_held & ~flash_mine);
+
+wire slow_fetch = fetch_addr[SLOW_ADDR_BIT] & ~fetch_hit_compressed;
+wire slow_load = state[EXECUTE_BIT] & is_load & load_store_addr[SLOW_ADDR_BIT];
+wire wfi_sleep = state[EXECUTE_BIT] & is_wfi & ~irq_pending;
+
+wire fetch_hold = BARREL && ((slow_fetch & flash_blocked) | ~hart_run[hart] | wfi_sleep);
+wire load_hold = BARREL && slow_load && flash_blocked;
+
+// Through the instruction cache a flash fetch is strobed like a RAM one,
+// and the hart only parks when the cache reports a miss (it then fills
+// the line, and the fetch hits once the hart runs again)
+wire park_fetch = fetch_start & slow_fetch & (~ICACHE | flash_blocked);
+wire fetch_miss = ICACHE && state[WAIT_INSTR_BIT] && pc[SLOW_ADDR_BIT] && imem_rbusy;
+
+wire park_flash = BARREL && ~flash_mine && (park_fetch | slow_load);
+wire park_miss = BARREL && fetch_miss;
+wire park = park_flash | park_miss | (BARREL && fetch_start && (~hart_run[hart] | wfi_sleep));
+wire park_load = park & slow_load;
+
+wire flash_start = park_flash & ~(fetch_hold | load_hold);
+
+reg [HARTS-1:0] hart_runnable;
+reg [HART_BITS-1:0] next_hart;
+reg next_found;
+integer h;
+
+always @(*) begin
+    for (h = 0; h < HARTS; h = h + 1)
+        hart_runnable[h] = hart_run[h] &
+            (~hart_wait[h] | ~flash_busy_q & (~flash_held | flash_owner == h)) &
+            (~hart_sleep[h] | hart_mie_meie[h] & irq);
+
+    // Round robin, the current hart last
+    next_hart = hart;
+    next_found = 1'b0;
+    for (h = HARTS; h >= 1; h = h - 1) begin
+        if (hart_runnable[(hart + h) % HARTS]) begin
+            next_hart = (hart + h) % HARTS;
+            next_found = 1'b1;
+        end
+    end
+end
+
+always @(posedge clk) begin
+    flash_busy_q <= flash_busy;
+
+    if (reset) begin
+        hart_run <= 1;
+        hart_wait <= {HARTS{1'b0}};
+        hart_sleep <= {HARTS{1'b0}};
+        hart_decode <= {HARTS{1'b0}};
+        hart_buf_valid <= {HARTS{1'b0}};
+        for (h = 0; h < HARTS; h = h + 1)
+            hart_pc[h] <= RESET_ADDR[ADDR_WIDTH-1:0];
+        flash_resv <= 1'b0;
+    end else begin
+        if (park) begin
+            hart_pc[hart] <= park_load ? pc : fetch_pc;
+            hart_instr[hart] <= park_load ? instr : {14'b0, fetch_buf};
+            hart_instr_c[hart] <= instr_c;
+            hart_decode[hart] <= park_load;
+            hart_buf_valid[hart] <= ~park_load & fetch_hit;
+            hart_wait[hart] <= park_flash | park_miss;
+            hart_sleep[hart] <= wfi_sleep;
+        end
+
+        if (state[SWITCH_BIT] & next_found) begin
+            hart_wait[next_hart] <= 1'b0;
+            hart_sleep[next_hart] <= 1'b0;
+        end
+
+        if (flash_start) begin
+            flash_resv <= 1'b1;
+            flash_owner <= hart;
+        end else if ((load_sent | imem_rstrb) & flash_mine) begin
+            flash_resv <= 1'b0;
+        end
+
+        if (BARREL && csr_write && csr_id == CSR_MHARTRUN)
+            hart_run <= csr_wdata[HARTS-1:0];
+    end
+end
+
 wire predicate = (
     funct3_is[0] &   EQ |
     funct3_is[1] &  !EQ |
@@ -109,8 +556,10 @@ wire predicate = (
 
 reg [ADDR_WIDTH-1:0] pc;
 reg [31:2] instr;
+reg instr_c; // instr was expanded from a 16-bit instruction
 
 wire [ADDR_WIDTH-1:0] pc_plus_4 = pc + 4;
+wire [ADDR_WIDTH-1:0] pc_plus_len = instr_c ? pc + 2 : pc_plus_4;
 
 wire [ADDR_WIDTH-1:0] pc_plus_imm = pc + (
     instr[3] ? imm_j[ADDR_WIDTH-1:0] :
@@ -123,23 +572,65 @@ wire [ADDR_WIDTH-1:0] load_store_addr = rs1[ADDR_WIDTH-1:0] + (
 );
 
 wire [ADDR_WIDTH-1:0] next_pc = (
+    is_stalled ? pc :
+    is_mret ? {mepc, 1'b0} :
     is_jalr ? {alu_plus[ADDR_WIDTH-1:1], 1'b0} :
     (is_jal | (is_branch & predicate)) ? pc_plus_imm :
-    pc_plus_4
+    pc_plus_len
 );
 
-assign mem_addr = (state[WAIT_INSTR_BIT] | state[FETCH_INSTR_BIT]) ? {{ADDR_PAD{1'b0}}, pc} : (
-    state[EXECUTE_BIT] & ~is_load & ~is_store ?
-        {{ADDR_PAD{1'b0}}, next_pc} :
-        {{ADDR_PAD{1'b0}}, load_store_addr}
+/* ---------------- Instruction fetch ---------------- */
+// With RV32C the pc is halfword aligned. The upper half of the last
+// fetched word is kept in fetch_buf: a compressed instruction found there
+// needs no memory read, and a 32-bit one straddling two words only reads
+// the second word.
+reg [15:0] fetch_buf;
+reg [ADDR_WIDTH-1:0] fetch_buf_pc;
+reg fetch_buf_valid;
+reg fetch_from_buf; // the pending fetch started from fetch_buf
+reg fetch_read;     // the pending fetch strobed memory
+
+// Where execution continues, unless a trap redirects the fetch to mtvec
+wire [ADDR_WIDTH-1:0] seq_pc = state[EXECUTE_BIT] ? next_pc : pc;
+wire [ADDR_WIDTH-1:0] fetch_pc = trap ? {mtvec, 2'b00} : seq_pc;
+wire fetch_hit = RV32C && fetch_buf_valid && (fetch_pc == fetch_buf_pc);
+wire fetch_hit_compressed = fetch_hit && (fetch_buf[1:0] != 2'b11);
+wire [ADDR_WIDTH-1:0] fetch_addr = fetch_hit ? fetch_pc + 2 : fetch_pc;
+
+wire [15:0] fetch_lo = fetch_from_buf ? fetch_buf :
+    (pc[1] ? imem_rdata[31:16] : imem_rdata[15:0]);
+wire [15:0] fetch_hi = fetch_from_buf ? imem_rdata[15:0] : imem_rdata[31:16];
+wire fetch_compressed = RV32C && (fetch_lo[1:0] != 2'b11);
+
+// 32-bit instruction at pc + 2 of a word that was not buffered yet
+wire fetch_split = pc[1] & ~fetch_from_buf & ~fetch_compressed;
+
+wire [31:0] fetch_expanded;
+
+rvc_expand expand (
+  .instr_c(fetch_lo),
+  .instr(fetch_expanded)
 );
 
+wire [31:0] fetch_instr = fetch_compressed ? fetch_expanded : {fetch_hi, fetch_lo};
+
+// Every instruction starts the next fetch from EXECUTE, except with harts
+// for those that continue in WAIT_ALU_OR_MEM: parking a hart then would
+// leave them unfinished.
+wire fetch_start = (state[EXECUTE_BIT] & ~(BARREL & need_to_wait)) |
+    state[FETCH_INSTR_BIT];
+
+assign imem_addr = {{ADDR_PAD{1'b0}}, fetch_addr};
+assign mem_addr = {{ADDR_PAD{1'b0}}, load_store_addr};
+
 wire [31:0] write_back_data = (
     (is_lui           ? imm_u       : 32'b0) |
     (is_alu           ? alu_out     : 32'b0) |
     (is_auipc         ? {{ADDR_PAD{1'b0}}, pc_plus_imm} : 32'b0) |
-    (is_jalr | is_jal ? {{ADDR_PAD{1'b0}}, pc_plus_4}   : 32'b0) |
-    (is_load          ? load_data   : 32'b0)
+    (is_jalr | is_jal ? {{ADDR_PAD{1'b0}}, pc_plus_len} : 32'b0) |
+    (is_load          ? load_data   : 32'b0) |
+    (is_md            ? md_out      : 32'b0) |
+    (is_csr           ? csr_rdata   : 32'b0)
 );
 
 wire mem_byte_access = (instr[13:12] == 2'b00);
@@ -177,48 +668,112 @@ localparam FETCH_INSTR_BIT     = 0;
 localparam WAIT_INSTR_BIT      = 1;
 localparam EXECUTE_BIT         = 2;
 localparam WAIT_ALU_OR_MEM_BIT = 3;
-localparam NB_STATES           = 4;
+localparam DECODE_BIT          = 4;
+localparam SWITCH_BIT          = 5;
+localparam NB_STATES           = 6;
 
 localparam FETCH_INSTR     = 1 << FETCH_INSTR_BIT;
 localparam WAIT_INSTR      = 1 << WAIT_INSTR_BIT;
 localparam EXECUTE         = 1 << EXECUTE_BIT;
 localparam WAIT_ALU_OR_MEM = 1 << WAIT_ALU_OR_MEM_BIT;
+localparam DECODE          = 1 << DECODE_BIT;  // resume a parked load
+localparam SWITCH          = 1 << SWITCH_BIT;  // pick the next hart to run
 
 (* onehot *)
 reg [NB_STATES-1:0] state;
 
-wire write_back = ~(is_branch | is_store) &
+wire write_back = ~(is_branch | is_store) & ~park_load &
     (state[EXECUTE_BIT] | state[WAIT_ALU_OR_MEM_BIT]);
 
-assign mem_rstrb = state[EXECUTE_BIT] & ~is_store | state[FETCH_INSTR_BIT];
-assign mem_wmask = {4{state[EXECUTE_BIT] & is_store}} & store_wmask;
+// A load or store is requested from EXECUTE, then from WAIT_ALU_OR_MEM
+// until the bus takes it. An accepted store is done.
+reg mem_sent;
 
-wire need_to_wait = is_load | is_store;
+assign mem_req = (is_load | is_store) & ~load_hold &
+    (state[EXECUTE_BIT] | (state[WAIT_ALU_OR_MEM_BIT] & ~mem_sent));
+assign imem_rstrb = fetch_start & ~fetch_hit_compressed & ~fetch_hold;
+assign mem_wmask = {4{mem_req & is_store}} & store_wmask;
+
+wire load_sent = mem_req & mem_ready & is_load;
+wire mem_done = (~is_load | mem_rvalid) & (~is_store | mem_ready);
+
+wire need_to_wait = is_load | (is_store & ~mem_ready) | is_md;
+
+// The fetch started from EXECUTE overlaps the data access or MUL/DIV/FXP
+// iterations, then WAIT_ALU_OR_MEM can skip FETCH_INSTR.
+reg prefetched;
 
 always @(posedge clk) begin
   if (reset) begin
-      state <= WAIT_ALU_OR_MEM;
+      state <= FETCH_INSTR;
       pc <= RESET_ADDR[ADDR_WIDTH-1:0];
-  end else
+      prefetched <= 1'b0;
+      fetch_buf_valid <= 1'b0;
+      hart <= 0;
+  end else begin
+  if (fetch_start) begin
+      fetch_from_buf <= fetch_hit;
+      fetch_read <= ~fetch_hit_compressed;
+  end
 
   (* parallel_case *)
   case (1'b1)
     state[WAIT_INSTR_BIT]: begin
-        if (!mem_rbusy) begin
-            rs1 <= registers[mem_rdata[19:15]];
-            rs2 <= registers[mem_rdata[24:20]];
-            instr <= mem_rdata[31:2];
-            state <= EXECUTE;
+        if (!imem_rbusy) begin
+            if (fetch_read) begin
+                fetch_buf <= imem_rdata[31:16];
+                fetch_buf_pc <= fetch_from_buf ? pc_plus_4 : {pc[ADDR_WIDTH-1:2], 2'b10};
+                fetch_buf_valid <= 1'b1;
+            end
+
+            if (fetch_split) begin
+                state <= FETCH_INSTR;
+            end else begin
+                rs1 <= registers[{hart, fetch_instr[19:15]}];
+                rs2 <= registers[{hart, fetch_instr[24:20]}];
+                instr <= fetch_instr[31:2];
+                instr_c <= fetch_compressed;
+                state <= EXECUTE;
+            end
         end
     end
 
     state[EXECUTE_BIT]: begin
-        if (!is_system) pc <= next_pc;
+        if (is_store && load_store_addr[ADDR_WIDTH-1:2] == fetch_buf_pc[ADDR_WIDTH-1:2])
+            fetch_buf_valid <= 1'b0;
+        pc <= fetch_pc;
         state <= need_to_wait ? WAIT_ALU_OR_MEM : WAIT_INSTR;
+        prefetched <= ~BARREL;
+        mem_sent <= mem_ready;
     end
 
     state[WAIT_ALU_OR_MEM_BIT]: begin
-        if (!mem_rbusy) state <= FETCH_INSTR;
+        if (mem_ready) mem_sent <= 1'b1;
+        if (mem_done && !md_busy) state <= prefetched ? WAIT_INSTR : FETCH_INSTR;
+    end
+
+    state[FETCH_INSTR_BIT]: begin
+        pc <= fetch_pc;
+        state <= WAIT_INSTR;
+    end
+
+    state[DECODE_BIT]: begin
+        rs1 <= registers[{hart, rs1_id}];
+        rs2 <= registers[{hart, rs2_id}];
+        state <= EXECUTE;
+    end
+
+    state[SWITCH_BIT]: begin
+        if (next_found) begin
+            hart <= next_hart;
+            pc <= hart_pc[next_hart];
+            instr <= hart_instr[next_hart];
+            instr_c <= hart_instr_c[next_hart];
+            fetch_buf <= hart_instr[next_hart][17:2];
+            fetch_buf_pc <= hart_pc[next_hart];
+            fetch_buf_valid <= hart_buf_valid[next_hart];
+            state <= hart_decode[next_hart] ? DECODE : FETCH_INSTR;
+        end
     end
 
     default: begin
@@ -226,5 +781,8 @@ always @(posedge clk) begin
     end
 
   endcase
+
+  if (park) state <= SWITCH;
+  end
 end
 endmodule
@@ -0,0 +1,282 @@
+`default_nettype none
+
+// Three stage RV32I core: fetch / decode + register read / execute + write back.
+// Same data bus as riscv_32i (fetches go over it too), selected with
+// CPU_PIPELINE in system.v.
+module riscv_32i_pipe (
+  input clk, reset,
+  input [31:0] mem_rdata,
+  input mem_ready,
+  input mem_rvalid,
+  output [31:0] mem_addr,
+  output mem_req,
+  output [31:0] mem_wdata,
+  output [3:0] mem_wmask
+);
+
+localparam RESET_ADDR = 32'h00810000;
+localparam ADDR_WIDTH = 24;
+localparam ADDR_PAD = 32 - ADDR_WIDTH;
+
+/* ---------------- Fetch ---------------- */
+reg [ADDR_WIDTH-1:0] fetch_pc;    // next sequential fetch address
+reg [ADDR_WIDTH-1:0] fetched_pc;  // address of the word in flight
+reg fetch_pending;                // fetched word is in flight / on mem_rdata
+
+/* ---------------- Decode ---------------- */
+// The fetched word only stays on mem_rdata until the next read request,
+// so it is parked here when execute takes the bus for a load.
+reg [31:2] skid_instr;
+reg [ADDR_WIDTH-1:0] skid_pc;
+reg skid_valid;
+
+wire d_valid = skid_valid | fetch_pending;
+wire [31:2] d_instr = skid_valid ? skid_instr : mem_rdata[31:2];
+wire [ADDR_WIDTH-1:0] d_pc = skid_valid ? skid_pc : fetched_pc;
+
+/* ---------------- Execute ---------------- */
+reg [31:2] instr;
+reg [ADDR_WIDTH-1:0] pc;
+reg x_valid;
+reg load_wait;                    // load taken, data arrives with mem_rvalid
+
+wire is_alu_reg = (instr[6:2] == 5'b01100); // reg <= reg op reg
+wire is_alu_imm = (instr[6:2] == 5'b00100); // reg <= reg op imm
+wire is_branch  = (instr[6:2] == 5'b11000); // if (reg op reg) pc <= pc + imm
+wire is_jalr    = (instr[6:2] == 5'b11001); // reg <= pc + 4 ; pc <= reg + imm
+wire is_jal     = (instr[6:2] == 5'b11011); // reg <= pc + 4 ; pc <= pc + imm
+wire is_auipc   = (instr[6:2] == 5'b00101); // reg <= pc + (imm << 12)
+wire is_lui     = (instr[6:2] == 5'b01101); // reg <= (imm << 12)
+wire is_load    = (instr[6:2] == 5'b00000); // reg <= mem[reg + imm]
+wire is_store   = (instr[6:2] == 5'b01000); // mem[reg + imm] <= reg
+wire is_system  = (instr[6:2] == 5'b11100); // halts the pipeline
+wire is_alu = is_alu_reg | is_alu_imm;
+
+wire [4:0] rd_id  = instr[11:7];
+
+(* onehot *)
+wire [7:0] funct3_is = 8'h01 << instr[14:12];
+
+wire [31:0] imm_u = {instr[31], instr[30:12], {12{1'b0}}};
+wire [31:0] imm_i = {{21{instr[31]}}, instr[30:20]};
+wire [31:0] imm_s = {{21{instr[31]}}, instr[30:25], instr[11:7]};
+wire [31:0] imm_b = {{20{instr[31]}}, instr[7], instr[30:25], instr[11:8], 1'b0};
+wire [31:0] imm_j = {{12{instr[31]}}, instr[19:12], instr[20], instr[30:21], 1'b0};
+
+(* no_rw_check *)
+reg [31:0] registers [32];
+reg [31:0] rs1_q, rs2_q;
+
+// Operand forwarding: an instruction entering execute on the same edge
+// as the previous one writes back reads the stale register file entry.
+reg rs1_fwd, rs2_fwd;
+reg [31:0] fwd_data;
+
+wire [31:0] rs1 = rs1_fwd ? fwd_data : rs1_q;
+wire [31:0] rs2 = rs2_fwd ? fwd_data : rs2_q;
+
+always @(posedge clk) begin
+    if (write_back && rd_id != 0) begin
+        registers[rd_id] <= write_back_data;
+    end
+end
+
+always @(posedge clk) begin
+    if (d_advance) begin
+        rs1_q <= registers[d_instr[19:15]];
+        rs2_q <= registers[d_instr[24:20]];
+    end
+end
+
+wire [31:0] alu_a = rs1;
+wire [31:0] alu_b = (is_alu_reg | is_branch) ? rs2 : imm_i;
+
+wire [31:0] alu_plus = alu_a + alu_b;
+wire [32:0] alu_minus = {1'b0, alu_a} - {1'b0, alu_b};
+
+wire EQ = (alu_minus[31:0] == 0);
+wire LT = (alu_a[31] ^ alu_b[31]) ? alu_a[31] : alu_minus[32];
+wire LTU = alu_minus[32];
+
+wire [31:0] shifter_in = funct3_is[1] ? {
+    alu_a[00], alu_a[01], alu_a[02], alu_a[03],
+    alu_a[04], alu_a[05], alu_a[06], alu_a[07],
+    alu_a[08], alu_a[09], alu_a[10], alu_a[11],
+    alu_a[12], alu_a[13], alu_a[14], alu_a[15],
+    alu_a[16], alu_a[17], alu_a[18], alu_a[19],
+    alu_a[20], alu_a[21], alu_a[22], alu_a[23],
+    alu_a[24], alu_a[25], alu_a[26], alu_a[27],
+    alu_a[28], alu_a[29], alu_a[30], alu_a[31]
+} : alu_a;
+
+wire signed [32:0] shifter_wide =
+    $signed({instr[30] & alu_a[31], shifter_in}) >>> alu_b[4:0];
+
+wire [31:0] shifter = shifter_wide[31:0];
+
+wire [31:0] left_shift = {
+    shifter[00], shifter[01], shifter[02], shifter[03],
+    shifter[04], shifter[05], shifter[06], shifter[07],
+    shifter[08], shifter[09], shifter[10], shifter[11],
+    shifter[12], shifter[13], shifter[14], shifter[15],
+    shifter[16], shifter[17], shifter[18], shifter[19],
+    shifter[20], shifter[21], shifter[22], shifter[23],
+    shifter[24], shifter[25], shifter[26], shifter[27],
+    shifter[28], shifter[29], shifter[30], shifter[31]
+};
+
+wire [31:0] alu_out = (
+    (funct3_is[0] ? (instr[30] & instr[5] ? alu_minus[31:0] : alu_plus) : 32'b0) |
+    (funct3_is[1] ? left_shift                                          : 32'b0) |
+    (funct3_is[2] ? {31'b0, LT}                                         : 32'b0) |
+    (funct3_is[3] ? {31'b0, LTU}                                        : 32'b0) |
+    (funct3_is[4] ? alu_a ^ alu_b                                       : 32'b0) |
+    (funct3_is[5] ? shifter                                             : 32'b0) |
+    (funct3_is[6] ? alu_a | alu_b                                       : 32'b0) |
+    (funct3_is[7] ? alu_a & alu_b                                       : 32'b0)
+);
+
+wire predicate = (
+    funct3_is[0] &   EQ |
+    funct3_is[1] &  !EQ |
+    funct3_is[4] &   LT |
+    funct3_is[5] &  !LT |
+    funct3_is[6] &  LTU |
+    funct3_is[7] & !LTU
+);
+
+wire [ADDR_WIDTH-1:0] pc_plus_4 = pc + 4;
+
+wire [ADDR_WIDTH-1:0] pc_plus_imm = pc + (
+    instr[3] ? imm_j[ADDR_WIDTH-1:0] :
+    instr[4] ? imm_u[ADDR_WIDTH-1:0] :
+    imm_b[ADDR_WIDTH-1:0]
+);
+
+wire [ADDR_WIDTH-1:0] load_store_addr = rs1[ADDR_WIDTH-1:0] + (
+    instr[5] ? imm_s[ADDR_WIDTH-1:0] : imm_i[ADDR_WIDTH-1:0]
+);
+
+wire [ADDR_WIDTH-1:0] next_pc = (
+    is_jalr ? {alu_plus[ADDR_WIDTH-1:1], 1'b0} : pc_plus_imm
+);
+
+wire [31:0] write_back_data = (
+    (is_lui           ? imm_u       : 32'b0) |
+    (is_alu           ? alu_out     : 32'b0) |
+    (is_auipc         ? {{ADDR_PAD{1'b0}}, pc_plus_imm} : 32'b0) |
+    (is_jalr | is_jal ? {{ADDR_PAD{1'b0}}, pc_plus_4}   : 32'b0) |
+    (is_load          ? load_data   : 32'b0)
+);
+
+wire mem_byte_access = (instr[13:12] == 2'b00);
+wire mem_half_word_access = (instr[13:12] == 2'b01);
+
+wire load_sign = !instr[14] & (mem_byte_access ? load_byte[7] : load_half_word[15]);
+
+wire [31:0] load_data = (
+  mem_byte_access ? {{24{load_sign}}, load_byte} :
+  mem_half_word_access ? {{16{load_sign}}, load_half_word} :
+  mem_rdata
+);
+
+wire [15:0] load_half_word = load_store_addr[1] ? mem_rdata[31:16] : mem_rdata[15:0];
+wire [7:0] load_byte = load_store_addr[0] ? load_half_word[15:8] : load_half_word[7:0];
+
+assign mem_wdata[7:0] = rs2[7:0];
+assign mem_wdata[15:8] = load_store_addr[0] ? rs2[7:0] : rs2[15:8];
+assign mem_wdata[23:16] = load_store_addr[1] ? rs2[7:0] : rs2[23:16];
+assign mem_wdata[31:24] = load_store_addr[0] ? rs2[7:0] : (
+    load_store_addr[1] ? rs2[15:8] : rs2[31:24]
+);
+
+wire [3:0] store_wmask = mem_byte_access ? (
+    load_store_addr[1] ?
+        (load_store_addr[0] ? 4'b1000 : 4'b0100) :
+        (load_store_addr[0] ? 4'b0010 : 4'b0001)
+) : (
+    mem_half_word_access ?
+        (load_store_addr[1] ? 4'b1100 : 4'b0011) :
+        4'b1111
+);
+
+/* ---------------- Pipeline control ---------------- */
+// One read is in flight at a time. RAM and IO answer on the next cycle,
+// flash later: the pipeline freezes until mem_rvalid, and the next request
+// may go out on the cycle the data comes back.
+wire stall = (fetch_pending | load_wait) & ~mem_rvalid;
+
+wire mem_access = x_valid & ~load_wait & (is_load | is_store);
+wire bus_busy = ~stall & mem_access;
+
+// A load or store the slave does not take stays in execute and retries.
+// mem_addr is selected by bus_busy alone, so mem_ready does not feed back
+// into the address it was decoded from.
+wire mem_hold = bus_busy & ~mem_ready;
+
+wire x_done = x_valid & (
+    load_wait ? mem_rvalid : ~stall & ~mem_hold & ~(is_load | is_system)
+);
+
+wire write_back = x_done & ~(is_branch | is_store);
+
+wire redirect = ~stall & x_valid & ~load_wait &
+    (is_jal | is_jalr | (is_branch & predicate));
+
+// Load-use hazards need no extra bubble: decode waits while a load
+// is in execute and picks the loaded value up through forwarding.
+wire d_advance = ~stall & d_valid & (~x_valid | x_done) & ~redirect;
+
+wire fetch = ~stall & ~bus_busy & (~d_valid | d_advance | redirect);
+wire [ADDR_WIDTH-1:0] fetch_addr = redirect ? next_pc : fetch_pc;
+
+wire fetch_taken = fetch & mem_ready;
+
+assign mem_addr = {{ADDR_PAD{1'b0}}, bus_busy ? load_store_addr : fetch_addr};
+assign mem_req = fetch | bus_busy;
+assign mem_wmask = {4{bus_busy & is_store}} & store_wmask;
+
+always @(posedge clk) begin
+  if (reset) begin
+      fetch_pc <= RESET_ADDR[ADDR_WIDTH-1:0];
+      fetch_pending <= 1'b0;
+      skid_valid <= 1'b0;
+      x_valid <= 1'b0;
+      load_wait <= 1'b0;
+  end else if (!stall) begin
+      if (x_done) begin
+          x_valid <= 1'b0;
+          load_wait <= 1'b0;
+      end
+
+      if (bus_busy & is_load & mem_ready) begin
+          load_wait <= 1'b1;
+      end
+
+      if (d_advance) begin
+          instr <= d_instr;
+          pc <= d_pc;
+          x_valid <= 1'b1;
+          rs1_fwd <= write_back && rd_id != 0 && rd_id == d_instr[19:15];
+          rs2_fwd <= write_back && rd_id != 0 && rd_id == d_instr[24:20];
+          fwd_data <= write_back_data;
+      end
+
+      if (d_advance | redirect) begin
+          skid_valid <= 1'b0;
+      end else if (fetch_pending) begin
+          skid_instr <= mem_rdata[31:2];
+          skid_pc <= fetched_pc;
+          skid_valid <= 1'b1;
+      end
+
+      fetch_pending <= fetch_taken;
+      if (fetch_taken) begin
+          fetched_pc <= fetch_addr;
+          fetch_pc <= fetch_addr + 4;
+      end else if (redirect) begin
+          fetch_pc <= next_pc;
+      end
+  end
+end
+endmodule
@@ -0,0 +1,120 @@
+`default_nettype none
+
+// RV32C: expands a 16-bit compressed instruction into its 32-bit equivalent.
+// Reserved / floating point encodings expand to 0, which riscv_32i traps as
+// an illegal instruction (mcause 2) with MTRAP.
+module rvc_expand (
+  input [15:0] instr_c,
+  output reg [31:0] instr
+);
+
+localparam OP_LOAD   = 7'b0000011;
+localparam OP_IMM    = 7'b0010011;
+localparam OP_STORE  = 7'b0100011;
+localparam OP_REG    = 7'b0110011;
+localparam OP_LUI    = 7'b0110111;
+localparam OP_BRANCH = 7'b1100011;
+localparam OP_JALR   = 7'b1100111;
+localparam OP_JAL    = 7'b1101111;
+
+wire [1:0] quadrant = instr_c[1:0];
+wire [2:0] funct3 = instr_c[15:13];
+
+// Full and 3-bit (x8..x15) register fields
+wire [4:0] rd      = instr_c[11:7];
+wire [4:0] rs2     = instr_c[6:2];
+wire [4:0] rd_p    = {2'b01, instr_c[4:2]};
+wire [4:0] rs1_p   = {2'b01, instr_c[9:7]};
+
+wire [11:0] imm6     = {{7{instr_c[12]}}, instr_c[6:2]};
+wire [11:0] imm_lw   = {5'b0, instr_c[5], instr_c[12:10], instr_c[6], 2'b00};
+wire [11:0] imm_lwsp = {4'b0, instr_c[3:2], instr_c[12], instr_c[6:4], 2'b00};
+wire [11:0] imm_swsp = {4'b0, instr_c[8:7], instr_c[12:9], 2'b00};
+wire [11:0] imm_4spn = {2'b0, instr_c[10:7], instr_c[12:11], instr_c[5], instr_c[6], 2'b00};
+wire [11:0] imm_16sp = {{3{instr_c[12]}}, instr_c[4:3], instr_c[5], instr_c[2], instr_c[6], 4'b0};
+wire [19:0] imm_lui  = {{15{instr_c[12]}}, instr_c[6:2]};
+
+wire [20:0] imm_j = {{10{instr_c[12]}}, instr_c[8], instr_c[10:9], instr_c[6],
+                     instr_c[7], instr_c[2], instr_c[11], instr_c[5:3], 1'b0};
+wire [12:0] imm_b = {{5{instr_c[12]}}, instr_c[6:5], instr_c[2], instr_c[11:10],
+                     instr_c[4:3], 1'b0};
+
+wire [19:0] jal_j = {imm_j[20], imm_j[10:1], imm_j[11], imm_j[19:12]};
+wire [6:0]  b_hi  = {imm_b[12], imm_b[10:5]};
+wire [4:0]  b_lo  = {imm_b[4:1], imm_b[11]};
+
+always @(*) begin
+    instr = 32'b0;
+
+    case (quadrant)
+    2'b00: case (funct3)
+        3'b000: if (imm_4spn != 0) // c.addi4spn
+            instr = {imm_4spn, 5'd2, 3'b000, rd_p, OP_IMM};
+        3'b010: // c.lw
+            instr = {imm_lw, rs1_p, 3'b010, rd_p, OP_LOAD};
+        3'b110: // c.sw
+            instr = {imm_lw[11:5], rd_p, rs1_p, 3'b010, imm_lw[4:0], OP_STORE};
+        default: ;
+    endcase
+
+    2'b01: case (funct3)
+        3'b000: // c.addi / c.nop
+            instr = {imm6, rd, 3'b000, rd, OP_IMM};
+        3'b001: // c.jal
+            instr = {jal_j, 5'd1, OP_JAL};
+        3'b010: // c.li
+            instr = {imm6, 5'd0, 3'b000, rd, OP_IMM};
+        3'b011: if (rd == 5'd2) // c.addi16sp
+            instr = {imm_16sp, 5'd2, 3'b000, 5'd2, OP_IMM};
+        else // c.lui
+            instr = {imm_lui, rd, OP_LUI};
+        3'b100: case (instr_c[11:10])
+            2'b00: // c.srli
+                instr = {7'b0000000, rs2, rs1_p, 3'b101, rs1_p, OP_IMM};
+            2'b01: // c.srai
+                instr = {7'b0100000, rs2, rs1_p, 3'b101, rs1_p, OP_IMM};
+            2'b10: // c.andi
+                instr = {imm6, rs1_p, 3'b111, rs1_p, OP_IMM};
+            2'b11: if (!instr_c[12]) case (instr_c[6:5])
+                2'b00: instr = {7'b0100000, rd_p, rs1_p, 3'b000, rs1_p, OP_REG}; // c.sub
+                2'b01: instr = {7'b0000000, rd_p, rs1_p, 3'b100, rs1_p, OP_REG}; // c.xor
+                2'b10: instr = {7'b0000000, rd_p, rs1_p, 3'b110, rs1_p, OP_REG}; // c.or
+                2'b11: instr = {7'b0000000, rd_p, rs1_p, 3'b111, rs1_p, OP_REG}; // c.and
+            endcase
+        endcase
+        3'b101: // c.j
+            instr = {jal_j, 5'd0, OP_JAL};
+        3'b110: // c.beqz
+            instr = {b_hi, 5'd0, rs1_p, 3'b000, b_lo, OP_BRANCH};
+        3'b111: // c.bnez
+            instr = {b_hi, 5'd0, rs1_p, 3'b001, b_lo, OP_BRANCH};
+    endcase
+
+    2'b10: case (funct3)
+        3'b000: // c.slli
+            instr = {7'b0000000, rs2, rd, 3'b001, rd, OP_IMM};
+        3'b010: // c.lwsp
+            instr = {imm_lwsp, 5'd2, 3'b010, rd, OP_LOAD};
+        3'b100: if (!instr_c[12]) begin
+            if (rs2 == 0) // c.jr
+                instr = {12'b0, rd, 3'b000, 5'd0, OP_JALR};
+            else // c.mv
+                instr = {7'b0000000, rs2, 5'd0, 3'b000, rd, OP_REG};
+        end else begin
+            if (rs2 == 0 && rd == 0) // c.ebreak
+                instr = 32'h00100073;
+            else if (rs2 == 0) // c.jalr
+                instr = {12'b0, rd, 3'b000, 5'd1, OP_JALR};
+            else // c.add
+                instr = {7'b0000000, rs2, rd, 3'b000, rd, OP_REG};
+        end
+        3'b110: // c.swsp
+            instr = {imm_swsp[11:5], rs2, 5'd2, 3'b010, imm_swsp[4:0], OP_STORE};
+        default: ;
+    endcase
+
+    default: ;
+    endcase
+end
+
+endmodule
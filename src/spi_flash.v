@@ -1,11 +1,34 @@
 `default_nettype none
 
-module spi_flash (
+// SPI flash reader. The bus side runs on clk, the SPI engine on spi_clk_in,
+// which also drives SCK: clk itself, or a faster PLL clock for flash parts
+// that take it. Requests cross into the SPI domain with a toggle and the
+// words come back the same way (each one stays in spi_word for 32 SCK
+// cycles, long enough for the synchroniser).
+//
+// A strobe with cmd sends cmd_out instead (Write Enable, Page Program,
+// Sector Erase, Read Status...) in a CS# low period of its own, catching
+// MISO; status is the last byte caught. With cmd_wait the controller then
+// polls Read Status until the flash has finished writing, staying busy, so
+// reads wait for the new contents.
+module spi_flash #(
+    parameter FAST_READ      = 1,  // Fast Read (0x0B) + 8 dummy clocks, else READ (0x03)
+    parameter CS_HIGH_CYCLES = 6   // CS# high time between commands (tSHSL), in spi_clk_in cycles
+) (
     input  wire        clk,             // 25 MHz
+    input  wire        spi_clk_in,      // SCK source
     input  wire        rstrb,           // Read strobe
-    input  wire [14:0] word_address,    // 128KB addressable
+    input  wire [21:0] word_address,    // 24-bit flash addresses, up to 16 MB
+    input  wire [3:0]  burst,           // words to read after the first one
     output wire [31:0] rdata,           // data word
-    output wire        rbusy,           // busy bit
+    output reg         rbusy,           // busy bit
+    output reg         rword,           // a word of the burst is on rdata
+
+    input  wire        cmd,             // with rstrb: send cmd_out, no read
+    input  wire [63:0] cmd_out,         // MSB first
+    input  wire [6:0]  cmd_bits,        // bits of cmd_out to send
+    input  wire        cmd_wait,        // then poll Read Status until WIP is 0
+    output wire [7:0]  status,
 
     output wire        spi_clk,         // SPI_CLK  pin 48
     output reg         spi_cs_n,        // SPI_CS   pin 49
@@ -13,49 +36,205 @@ module spi_flash (
     input  wire        spi_miso         // SPI_MISO pin 46
 );
 
-// Send 32 bits (8 cmd + 24 address)
-reg [5:0]  snd_bitcount = 6'd0;
-reg [31:0] cmd_addr     = 32'h0;
+localparam CMD_BITS = FAST_READ ? 40 : 32;
+localparam [7:0] CMD = FAST_READ ? 8'h0B : 8'h03;
+localparam [7:0] CMD_RDSR = 8'h05;
+
+/* ---------------- Bus side (clk) ---------------- */
+reg        req_toggle   = 1'b0;
+reg [21:0] req_address;
+reg [3:0]  req_burst;
+reg [3:0]  words_left;
+reg [31:0] word_data    = 32'h0;
+reg [31:0] spi_word     = 32'h0;  // SPI side: last word read
+reg        word_toggle  = 1'b0;   // SPI side: flips with every word
+
+reg        req_cmd      = 1'b0;
+reg [63:0] req_out;
+reg [6:0]  req_bits;
+reg        polling      = 1'b0;   // Read Status until the write is done
+
+// Word of the last read: reading it again needs no transfer, rdata still
+// holds it (riscv_32i harts replay their flash reads this way)
+reg [21:0] last_address = 22'h0;
+reg        last_valid   = 1'b0;
+
+reg [2:0]  word_sync    = 3'b000;
+wire       word_event   = word_sync[2] ^ word_sync[1];
+
+wire same = !cmd && burst == 0 && last_valid && word_address == last_address;
+
+initial rbusy = 1'b0;
+initial rword = 1'b0;
+
+// Re-order bytes correctly
+assign rdata = { word_data[7:0], word_data[15:8], word_data[23:16], word_data[31:24] };
+assign status = word_data[7:0];
+
+always @(posedge clk) begin
+    word_sync <= {word_sync[1:0], word_toggle};
+    rword <= 1'b0;
+
+    if (rstrb && same)
+        rword <= 1'b1;                                              // already on rdata
+
+    if (rstrb && cmd) begin
+        req_cmd      <= 1'b1;
+        req_out      <= cmd_out;
+        req_bits     <= cmd_bits;
+        req_toggle   <= ~req_toggle;
+        polling      <= cmd_wait;
+        rbusy        <= 1'b1;
+        last_valid   <= 1'b0;                                       // rdata gets the status
+    end
+
+    if (rstrb && !cmd && !same) begin
+        req_cmd      <= 1'b0;
+        req_address  <= word_address;
+        req_burst    <= burst;
+        req_toggle   <= ~req_toggle;
+        words_left   <= burst;
+        rbusy        <= 1'b1;
+        last_address <= word_address + burst;                       // ends on rdata
+        last_valid   <= 1'b1;
+    end
+
+    if (word_event) begin
+        word_data <= spi_word;
+        if (req_cmd) begin
+            // Read Status again while Write In Progress
+            if (polling && (req_out[63:56] != CMD_RDSR || spi_word[0])) begin
+                req_out    <= {CMD_RDSR, 56'h0};
+                req_bits   <= 7'd16;
+                req_toggle <= ~req_toggle;
+            end else begin
+                rbusy      <= 1'b0;
+            end
+        end else begin
+            rword <= 1'b1;
+            if (words_left == 0)
+                rbusy <= 1'b0;
+            else
+                words_left <= words_left - 4'd1;
+        end
+    end
+end
+
+/* ---------------- SPI side (spi_clk_in) ---------------- */
+// Send 32 bits (8 cmd + 24 address), + 8 dummy bits for Fast Read, or the
+// bits of a command
+reg [6:0]  snd_bitcount = 7'd0;
+reg [63:0] cmd_addr     = 64'h0;
+reg        spi_cmd      = 1'b0;
 
-// RX: receive 32 bits of data (1 word)
+// RX: receive 32 bits of data (1 word), burst_left more words after it
 reg [5:0]  rcv_bitcount = 6'd0;
 reg [31:0] rcv_data     = 32'h0;
+reg [3:0]  burst_left   = 4'd0;
+
+// Sequential reads: after a read CS# stays low with SCK stopped, and the
+// flash has the next word's first bit on MISO. A read of that word only
+// clocks in its 32 bits; any other address raises CS# for CS_HIGH_CYCLES
+// and sends a new command.
+reg        spi_clk_en   = 1'b0;
+reg        stream       = 1'b0;   // CS# low, paused before spi_next
+reg [21:0] spi_next;
+reg        restart      = 1'b0;   // waiting for CS# to have been high long enough
+reg [3:0]  cs_high      = 4'd0;
+
+reg [2:0]  req_sync     = 3'b000;
+wire       req_event    = req_sync[2] ^ req_sync[1];
 
 // Status flags
 wire sending   = (snd_bitcount != 0);
 wire receiving = (rcv_bitcount != 0);
-wire busy      = sending | receiving;
+wire last_bit  = rcv_bitcount == 6'd1;
+
+wire sequential = req_event && stream && !req_cmd && req_address == spi_next;
+wire start      = (restart || (req_event && !stream)) && cs_high == 0;
 
 initial spi_cs_n = 1'b1;
-assign spi_clk  = (!spi_cs_n) ? clk : 1'b0;
-assign rbusy = !spi_cs_n;
+assign spi_clk  = spi_clk_en ? spi_clk_in : 1'b0;
 
 // Drive MOSI with the MSB of the cmd/address shifter during TX phase.
-assign spi_mosi = cmd_addr[31];
+assign spi_mosi = cmd_addr[63];
 
-// Re-order bytes correctly
-assign rdata = { rcv_data[7:0], rcv_data[15:8], rcv_data[23:16], rcv_data[31:24] };
+always @(posedge spi_clk_in)
+    req_sync <= {req_sync[1:0], req_toggle};
 
-always @(negedge clk) begin
-    if (rstrb) begin
-        // 24-bit byte address = { 7'b0, word_address[14:0], 2'b00 }.
+always @(negedge spi_clk_in) begin
+    if (start) begin
+        // 24-bit byte address = { word_address, 2'b00 }.
         spi_cs_n     <= 1'b0;                                       // assert CS#
-        cmd_addr     <= {8'h03, 7'b0000000, word_address, 2'b00};   // READ (0x03) + addr
-        snd_bitcount <= 6'd32;                                      // send 32 bits total
+        spi_clk_en   <= 1'b1;
+        if (req_cmd) begin
+            cmd_addr     <= req_out;
+            snd_bitcount <= req_bits;
+        end else begin
+            cmd_addr     <= {CMD, req_address, 2'b00, 32'h0};   // cmd + addr (+ dummy)
+            snd_bitcount <= CMD_BITS;
+        end
+        spi_cmd      <= req_cmd;
+        burst_left   <= req_burst;
+        restart      <= 1'b0;
+    end else if (sequential) begin
+        // Continue the open READ
+        spi_clk_en   <= 1'b1;
+        rcv_bitcount <= 6'd32;
+        burst_left   <= req_burst;
+    end else if (req_event) begin
+        // Discontinuity: end the open READ, or wait for CS# to have been
+        // high long enough after a command
+        if (stream) begin
+            spi_cs_n <= 1'b1;
+            stream   <= 1'b0;
+            cs_high  <= CS_HIGH_CYCLES - 1;
+        end
+        restart      <= 1'b1;
     end else begin
+        if (cs_high != 0)
+            cs_high <= cs_high - 4'd1;
+
         if (sending) begin
-            if (snd_bitcount == 6'd1) rcv_bitcount <= 6'd32;   // next: receive 32 bits
-            snd_bitcount <= snd_bitcount - 6'd1;
-            cmd_addr     <= {cmd_addr[30:0], 1'b0};            // shift left, pad 0
+            if (snd_bitcount == 7'd1) begin
+                if (spi_cmd) begin
+                    // Command done: hand over what came in, raise CS#
+                    spi_word    <= {rcv_data[30:0], spi_miso};
+                    word_toggle <= ~word_toggle;
+                    spi_clk_en  <= 1'b0;
+                    spi_cs_n    <= 1'b1;
+                    cs_high     <= CS_HIGH_CYCLES - 1;
+                end else begin
+                    rcv_bitcount <= 6'd32;                     // next: receive 32 bits
+                end
+            end
+            snd_bitcount <= snd_bitcount - 7'd1;
+            cmd_addr     <= {cmd_addr[62:0], 1'b0};            // shift left, pad 0
         end
 
+        // MISO holds the bit driven on the previous falling edge
+        if (sending || receiving)
+            rcv_data <= {rcv_data[30:0], spi_miso};            // shift left, bring in MISO
+
         if (receiving) begin
-            rcv_bitcount <= rcv_bitcount - 6'd1;
-            rcv_data     <= {rcv_data[30:0], spi_miso};        // shift left, bring in MISO
-        end
+            if (last_bit) begin
+                spi_word    <= {rcv_data[30:0], spi_miso};
+                word_toggle <= ~word_toggle;
+            end
+
+            if (last_bit && burst_left != 0) begin
+                rcv_bitcount <= 6'd32;                          // the flash goes on with the next word
+                burst_left   <= burst_left - 4'd1;
+            end else begin
+                rcv_bitcount <= rcv_bitcount - 6'd1;
+            end
 
-        if (!busy) begin
-            spi_cs_n <= 1'b1; // Done, deassert CS
+            // Done: stop SCK before it shifts out the next word, keep CS# low
+            if (last_bit && burst_left == 0) begin
+                spi_clk_en <= 1'b0;
+                stream     <= 1'b1;
+                spi_next   <= req_address + req_burst + 1'b1;
+            end
         end
     end
 end
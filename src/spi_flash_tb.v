@@ -0,0 +1,280 @@
+`default_nettype none
+`timescale 1ns / 1ps
+
+// Simulation of spi_flash against a model of the M25P10 (apio sim
+// spi_flash_tb). The bus runs at 25 MHz, SCK at 50 MHz as with the PLL.
+module spi_flash_tb;
+
+reg clk = 1'b0;
+reg spi_clk_in = 1'b0;
+
+always #20 clk = ~clk;
+initial begin
+    #3;
+    forever #10 spi_clk_in = ~spi_clk_in;
+end
+
+reg rstrb = 1'b0;
+reg [21:0] word_address = 22'h0;
+reg [3:0] burst = 4'd0;
+wire [31:0] rdata;
+wire rbusy, rword;
+
+reg cmd = 1'b0;
+reg [63:0] cmd_out = 64'h0;
+reg [6:0] cmd_bits = 7'd0;
+reg cmd_wait = 1'b0;
+wire [7:0] status;
+
+wire sck, cs_n, mosi, miso;
+
+spi_flash #(
+    .FAST_READ(1)
+) dut (
+    .clk(clk),
+    .spi_clk_in(spi_clk_in),
+    .rstrb(rstrb),
+    .word_address(word_address),
+    .burst(burst),
+    .rdata(rdata),
+    .rbusy(rbusy),
+    .rword(rword),
+    .cmd(cmd),
+    .cmd_out(cmd_out),
+    .cmd_bits(cmd_bits),
+    .cmd_wait(cmd_wait),
+    .status(status),
+    .spi_clk(sck),
+    .spi_cs_n(cs_n),
+    .spi_mosi(mosi),
+    .spi_miso(miso)
+);
+
+spi_flash_model flash (
+    .sck(sck),
+    .cs_n(cs_n),
+    .mosi(mosi),
+    .miso(miso)
+);
+
+integer errors = 0;
+reg [31:0] expected;
+
+function [31:0] flash_word(input [21:0] a);
+    flash_word = {flash.mem[{a, 2'd3}], flash.mem[{a, 2'd2}],
+                  flash.mem[{a, 2'd1}], flash.mem[{a, 2'd0}]};
+endfunction
+
+// Strobes a read of n + 1 words and checks each one as rword shows it
+task read(input [21:0] a, input [3:0] n);
+    integer k;
+    begin
+        rstrb = 1'b1;
+        word_address = a;
+        burst = n;
+        @(posedge clk); #1;
+        rstrb = 1'b0;
+
+        k = 0;
+        while (k <= n) begin
+            if (rword) begin
+                if (rdata !== flash_word(a + k)) begin
+                    $display("FAIL word %h: %h, expected %h", a + k, rdata, flash_word(a + k));
+                    errors = errors + 1;
+                end
+                k = k + 1;
+            end
+            if (k <= n) begin
+                @(posedge clk); #1;
+            end
+        end
+
+        while (rbusy) begin
+            @(posedge clk); #1;
+        end
+        repeat (2) @(posedge clk);
+        #1;
+    end
+endtask
+
+// Sends a command and waits for it (and with w, for the write) to finish
+task command(input [63:0] out, input [6:0] bits, input w);
+    begin
+        rstrb = 1'b1;
+        cmd = 1'b1;
+        cmd_out = out;
+        cmd_bits = bits;
+        cmd_wait = w;
+        @(posedge clk); #1;
+        rstrb = 1'b0;
+        cmd = 1'b0;
+        while (rbusy) begin
+            @(posedge clk); #1;
+        end
+    end
+endtask
+
+task expect_status(input [7:0] s);
+    if (status !== s) begin
+        $display("FAIL status %h, expected %h", status, s);
+        errors = errors + 1;
+    end
+endtask
+
+task expect_commands(input integer n);
+    if (flash.commands != n) begin
+        $display("FAIL %0d flash commands, expected %0d", flash.commands, n);
+        errors = errors + 1;
+    end
+endtask
+
+initial begin
+`ifdef VCD_OUTPUT
+    $dumpfile(`VCD_OUTPUT);
+    $dumpvars(0, spi_flash_tb);
+`endif
+    repeat (4) @(posedge clk);
+    #1;
+
+    read(15'h0100, 0);  // command
+    read(15'h0100, 0);  // same word, no transfer
+    read(15'h0101, 0);  // sequential, READ stays open
+    read(15'h0102, 3);  // sequential burst
+    expect_commands(1);
+
+    read(15'h0200, 7);  // jump: new command
+    read(15'h0208, 7);  // next line
+    read(15'h0040, 0);  // jump back
+    read(15'h7FFF, 0);  // last word
+    expect_commands(4);
+
+    // Program a word over an open READ, wait for it, read it back
+    expected = flash_word(15'h0100) & 32'h44332211;
+    command({8'h06, 56'h0}, 8, 0);                          // Write Enable
+    command({8'h05, 56'h0}, 16, 0);                         // Read Status
+    expect_status(8'h02);
+    command({8'h02, 24'h000400, 32'h11223344}, 64, 1);      // Page Program
+    expect_status(8'h00);
+    if (flash_word(15'h0100) !== expected) begin
+        $display("FAIL programmed %h, expected %h", flash_word(15'h0100), expected);
+        errors = errors + 1;
+    end
+    read(15'h0100, 0);
+    expect_commands(5);
+
+    if (errors == 0)
+        $display("PASS");
+    else
+        $display("FAIL: %0d errors", errors);
+    $finish;
+end
+
+initial begin
+    #500000;
+    $display("FAIL: timeout");
+    $finish;
+end
+
+endmodule
+
+// M25P10: READ (0x03), Fast Read (0x0B, 8 dummy clocks), Read Status
+// (0x05), Write Enable (0x06), Page Program (0x02) and Sector Erase (0xD8),
+// the last two taking T_PP / T_SE. Commands are sampled on rising SCK
+// edges, data is shifted out MSB first T_CLQV after each falling edge and
+// held until the next one. Checks tSHSL and reads while writing.
+module spi_flash_model #(
+    parameter SIZE = 1 << 17,
+    parameter T_CLQV = 8,
+    parameter T_SHSL = 100,
+    parameter T_PP = 2000,
+    parameter T_SE = 5000
+) (
+    input wire sck,
+    input wire cs_n,
+    input wire mosi,
+    output reg miso
+);
+
+reg [7:0] mem [0:SIZE-1];
+reg [7:0] cmd;
+reg [23:0] addr;
+integer nbits;      // rising edges since CS# fell
+integer dbits;      // data bits shifted out
+integer commands = 0;
+realtime cs_rise = -1000.0;
+integer i;
+
+reg wel = 1'b0;                 // Write Enable Latch
+realtime wip_until = 0.0;       // Write In Progress until then
+reg [7:0] status;
+reg [7:0] page [0:255];         // Page Program data
+integer page_bytes;
+
+initial begin
+    miso = 1'bz;
+    for (i = 0; i < SIZE; i = i + 1)
+        mem[i] = (i * 7 + (i >> 8) + 8'h5A) & 8'hFF;
+end
+
+wire fast = (cmd == 8'h0B);
+wire reading = (cmd == 8'h03) || fast;
+wire rdsr = (cmd == 8'h05);
+wire data_phase = (reading && nbits >= (fast ? 40 : 32)) || (rdsr && nbits >= 8);
+
+always @(negedge cs_n) begin
+    if ($realtime - cs_rise < T_SHSL)
+        $display("FAIL tSHSL: CS# high for %0t ns", $realtime - cs_rise);
+    nbits = 0;
+    dbits = 0;
+    cmd = 8'h00;
+end
+
+always @(posedge cs_n) begin
+    cs_rise = $realtime;
+    miso <= #T_CLQV 1'bz;
+
+    if (cmd == 8'h06 && nbits == 8)
+        wel = 1'b1;
+
+    if (cmd == 8'h02 && wel && nbits >= 40 && nbits % 8 == 0) begin
+        page_bytes = (nbits - 32) / 8;
+        for (i = 0; i < page_bytes && i < 256; i = i + 1)
+            mem[{addr[23:8], 8'h00} + ((addr[7:0] + i) % 256)] =
+                mem[{addr[23:8], 8'h00} + ((addr[7:0] + i) % 256)] & page[i];
+        wel = 1'b0;
+        wip_until = $realtime + T_PP;
+    end
+
+    if (cmd == 8'hD8 && wel && nbits == 32) begin
+        for (i = 0; i < 32768; i = i + 1)
+            mem[({addr[23:15], 15'h0} + i) % SIZE] = 8'hFF;
+        wel = 1'b0;
+        wip_until = $realtime + T_SE;
+    end
+end
+
+always @(posedge sck) if (!cs_n) begin
+    if (nbits < 8)
+        cmd = {cmd[6:0], mosi};
+    else if (nbits < 32)
+        addr = {addr[22:0], mosi};
+    else
+        page[(nbits - 32) / 8 % 256] = {page[(nbits - 32) / 8 % 256][6:0], mosi};
+    nbits = nbits + 1;
+    if (nbits == 8 && reading && $realtime < wip_until)
+        $display("FAIL read while the flash is writing");
+    if (nbits == 8)
+        status = {6'b0, wel, $realtime < wip_until};
+    if (nbits == 32 && reading)
+        commands = commands + 1;
+end
+
+always @(negedge sck) if (!cs_n && data_phase) begin
+    if (rdsr)
+        miso <= #T_CLQV status[7 - dbits % 8];
+    else
+        miso <= #T_CLQV mem[(addr + dbits / 8) % SIZE][7 - dbits % 8];
+    dbits = dbits + 1;
+end
+
+endmodule
@@ -0,0 +1,122 @@
+`default_nettype none
+
+// SPI master for the PMOD OLED: a FIFO of bytes / halfwords, each with
+// its D/C level, shifted out MSB first on SCK / MOSI (mode 0). CS# is low
+// while entries are going out. SCK = clk / (2 * (DIV + 1)), DIV = 1 at
+// reset (6.25 MHz, the SSD1331 takes 6.6).
+//
+// Registers: 0 TX (write {dc, half, data[15:0]}; the bus waits while the
+// FIFO is full), 1 STATUS (read {present, ..., full, busy, level}),
+// 2 CTRL ({enable, div[7:0]}; enabled, the master drives SCK, MOSI, CS#
+// and D/C instead of the PMOD register). While hold is high (the DMA
+// engine owns the OLED pins) entries stay in the FIFO.
+module spi_master #(
+  parameter DEPTH_BITS = 2 // 4 entries
+) (
+  input clk,
+  input reset,
+
+  // Registers
+  input wstrb,
+  input [1:0] reg_addr,
+  input [31:0] wdata,
+  output reg [31:0] rdata,
+  output full,
+  input hold,
+
+  // OLED
+  output reg enable,
+  output reg sck,
+  output mosi,
+  output cs_n,
+  output reg dc
+);
+
+localparam DEPTH = 1 << DEPTH_BITS;
+
+localparam REG_TX = 0;
+localparam REG_STATUS = 1;
+localparam REG_CTRL = 2;
+
+localparam TX_HALF = 16;
+localparam TX_DC = 17;
+localparam CTRL_ENABLE = 8;
+
+reg [17:0] fifo [DEPTH];  // {dc, half, data}, read asynchronously: flip-flops
+reg [DEPTH_BITS-1:0] rd_ptr = 0;
+reg [DEPTH_BITS-1:0] wr_ptr = 0;
+reg [DEPTH_BITS:0] level = 0;
+reg [7:0] div;
+
+reg [15:0] shift;
+reg [4:0] bits = 5'd0;    // still to shift out
+reg [7:0] phase;
+
+wire [17:0] head = fifo[rd_ptr];
+wire push = wstrb & (reg_addr == REG_TX) & ~full;
+wire pop = (bits == 0) & (level != 0) & ~hold;
+wire busy = (bits != 0) | (level != 0);
+
+assign full = level == DEPTH;
+assign mosi = shift[15];
+assign cs_n = ~busy;
+
+initial begin
+    enable = 1'b0;
+    sck = 1'b0;
+    dc = 1'b1;
+end
+
+always @(*) begin
+    case (reg_addr)
+        REG_STATUS: rdata = {1'b1, 21'b0, full, busy, {(8-DEPTH_BITS-1){1'b0}}, level};
+        REG_CTRL: rdata = {23'b0, enable, div};
+        default: rdata = 32'b0;
+    endcase
+end
+
+always @(posedge clk) begin
+    if (reset) begin
+        rd_ptr <= 0;
+        wr_ptr <= 0;
+        level <= 0;
+        bits <= 5'd0;
+        sck <= 1'b0;
+        enable <= 1'b0;
+        div <= 8'd1;
+    end else begin
+        if (wstrb & (reg_addr == REG_CTRL)) begin
+            enable <= wdata[CTRL_ENABLE];
+            div <= wdata[7:0];
+        end
+
+        if (push) begin
+            fifo[wr_ptr] <= wdata[17:0];
+            wr_ptr <= wr_ptr + 1'b1;
+        end
+        if (pop)
+            rd_ptr <= rd_ptr + 1'b1;
+        level <= level + push - pop;
+
+        if (pop) begin
+            shift <= head[TX_HALF] ? head[15:0] : {head[7:0], 8'h00};
+            bits <= head[TX_HALF] ? 5'd16 : 5'd8;
+            dc <= head[TX_DC];
+            phase <= 8'd0;
+        end else if (bits != 0) begin
+            if (phase == div) begin
+                // MOSI moves on the falling edge, the OLED samples on the rising one
+                phase <= 8'd0;
+                sck <= ~sck;
+                if (sck) begin
+                    shift <= {shift[14:0], 1'b0};
+                    bits <= bits - 5'd1;
+                end
+            end else begin
+                phase <= phase + 1'b1;
+            end
+        end
+    end
+end
+
+endmodule
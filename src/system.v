@@ -12,12 +12,22 @@ module system (
     output OLED_DC, OLED_RES, OLED_VCC_EN, OLED_PMOD_EN
 );
 
+// Data bus: a request (a store when mem_wmask != 0) is taken by the slave
+// it addresses when mem_ready is high, read data follows with mem_rvalid
+// after a latency of the slave's own. Stores are posted.
 wire [31:0] mem_addr;
 wire [31:0] mem_rdata;
-wire mem_rstrb;
+wire mem_req;
+wire mem_ready;
+wire mem_rvalid;
 wire [31:0] mem_wdata;
 wire [3:0] mem_wmask;
-wire mem_rbusy;
+
+// Instruction bus of riscv_32i, riscv_32i_pipe fetches over mem_* as well
+wire [31:0] imem_addr;
+wire [31:0] imem_rdata;
+wire imem_rstrb;
+wire imem_rbusy;
 
 (* init = 0 *) reg [15:0] por_count;
 wire por_active = (por_count != {16{1'b1}});
@@ -29,55 +39,487 @@ end
 
 wire reset = por_active | SW1;
 
-riscv_32i cpu (
-  .clk(CLK),
-  .reset(reset),
-  .mem_addr(mem_addr),
-  .mem_rdata(mem_rdata),
-  .mem_rbusy(mem_rbusy),
-  .mem_rstrb(mem_rstrb),
-  .mem_wdata(mem_wdata),
-  .mem_wmask(mem_wmask)
-);
+// 0: multi-cycle riscv_32i, 1: three stage riscv_32i_pipe (RV32I only)
+localparam CPU_PIPELINE = 0;
+// Multi-cycle core extensions, off by default: the RV32I core is the
+// configuration known to fit the HX1K, each one adds logic on top of it.
+// Build programs to match (make RV32M=1 RV32C=1 ZICSR=1 ZBB=1 FXP=1).
+localparam CPU_RV32M = 0;
+localparam CPU_FXP = 0;     // needs CPU_RV32M
+localparam CPU_RV32C = 0;
+localparam CPU_ZBB = 0;
+localparam CPU_ZICSR = 0;
+localparam CPU_MTRAP = 0;   // needs CPU_ZICSR
+// 2..4 harts sharing the core, switched while one waits on flash
+localparam CPU_HARTS = 1;
+// 1: 1 KB instruction cache in front of flash (make ICACHE=1 for the
+// programs). BRAMs, of the HX1K's 16: the register file takes 4 (two read
+// ports), each 1 KB RAM bank 2. The cache's data takes 2 and its tags 1,
+// so it replaces two of the six banks (4 KB of RAM left, 15 BRAMs).
+localparam ICACHE = 0;
+// 1: two 4-word line buffers for loads from flash, with next line prefetch
+localparam FLASH_DBUF = 0;
+// Flash: Fast Read (0x0B), with SCK at 50 MHz from the PLL, else 25 MHz
+localparam FLASH_FAST_READ = 1;
+localparam FLASH_PLL = 0;
+// The peripherals below are off by default: with all of them the design
+// does not fit the 1280 LCs of the HX1K next to the core, so turn on the
+// ones a program needs.
+// Their rough sizes are estimates from the register widths, not from a
+// place and route. The C headers check each block's present bit and fall
+// back to software when it is off.
+// 1: DMA engine for block copies to RAM, ~150 FFs
+localparam DMA = 0;
+// 1: SPI master with a TX FIFO for the PMOD OLED (a store to the full
+// FIFO waits on mem_ready), ~120 FFs
+localparam OLED_SPI = 0;
+// 1: microsecond counter with a compare interrupt, ~70 FFs (cycle counts
+// come from mcycle)
+localparam TIMER = 0;
+// 1: debounced switches with latched press / release edges, else IRQ_SW
+// follows the raw switch inputs, ~60 FFs
+localparam SW_DEBOUNCE = 0;
+// 1: random number generator, a new 32-bit value every cycle, 64 FFs
+localparam PRNG = 0;
+// 1: CORDIC unit for Q16.16 sin / cos, atan2, magnitude and sqrt
+// (a read of a result waits on mem_ready), ~110 FFs and three 32-bit adders with barrel shifters
+localparam CORDIC = 0;
+
+wire cpu_irq;
+
+generate
+if (CPU_PIPELINE) begin : cpu_pipe
+  riscv_32i_pipe cpu (
+    .clk(CLK),
+    .reset(reset),
+    .mem_addr(mem_addr),
+    .mem_rdata(mem_rdata),
+    .mem_ready(mem_ready),
+    .mem_rvalid(mem_rvalid),
+    .mem_req(mem_req),
+    .mem_wdata(mem_wdata),
+    .mem_wmask(mem_wmask)
+  );
+
+  assign imem_addr = 32'b0;
+  assign imem_rstrb = 1'b0;
+end else begin : cpu_fsm
+  riscv_32i #(
+    .RV32M(CPU_RV32M),
+    .FXP(CPU_FXP),
+    .RV32C(CPU_RV32C),
+    .ZBB(CPU_ZBB),
+    .ZICSR(CPU_ZICSR),
+    .MTRAP(CPU_MTRAP),
+    .HARTS(CPU_HARTS),
+    .ICACHE(ICACHE)
+  ) cpu (
+    .clk(CLK),
+    .reset(reset),
+    .irq(cpu_irq),
+    .flash_busy(flash_busy),
+    .imem_addr(imem_addr),
+    .imem_rdata(imem_rdata),
+    .imem_rbusy(imem_rbusy),
+    .imem_rstrb(imem_rstrb),
+    .mem_addr(mem_addr),
+    .mem_rdata(mem_rdata),
+    .mem_ready(mem_ready),
+    .mem_rvalid(mem_rvalid),
+    .mem_req(mem_req),
+    .mem_wdata(mem_wdata),
+    .mem_wmask(mem_wmask)
+  );
+end
+endgenerate
 
 wire [31:0] ram_rdata;
 wire [29:0] mem_word_addr = mem_addr[31:2];
 wire is_spi = mem_addr[23];
 wire is_io = mem_addr[23:22] == 2'b01;
 wire is_ram = mem_addr[23:22] == 2'b00;
-wire mem_wstrb = |mem_wmask;
 
-memory ram (
+// A slave that cannot take a request (e.g. still busy with a previous
+// write) drops its ready while it is addressed. RAM is busy on the cycles
+// the DMA engine writes to it, the OLED SPI master while its FIFO is full,
+// the CORDIC unit's X / Y / Z until its result is there.
+wire ram_ready = ~dma_ram_wstrb;
+wire io_ready = ~(io_oled_spi & (io_reg == 0) & oled_spi_full) &
+    ~(io_cordic & (io_reg != 3) & cordic_busy);
+wire spi_ready = 1'b1; // flash_arbiter queues the read
+assign mem_ready = is_ram ? ram_ready : is_io ? io_ready : spi_ready;
+
+wire mem_accept = mem_req & mem_ready;
+wire mem_wstrb = mem_accept & (|mem_wmask);
+wire mem_rstrb = mem_accept & ~(|mem_wmask);
+
+// Instructions come from RAM or flash
+wire imem_is_spi = imem_addr[23];
+
+wire [31:0] ram_irdata;
+wire ram_irbusy;
+
+memory #(
+  .BANKS(6 - 2 * ICACHE)
+) ram (
   .clk(CLK),
-  .mem_addr(mem_addr),
+  .i_addr(imem_addr),
+  .i_rdata(ram_irdata),
+  .i_rstrb(~imem_is_spi & imem_rstrb),
+  .i_rbusy(ram_irbusy),
+  .mem_addr(dma_ram ? dma_ram_addr : mem_addr),
   .mem_rdata(ram_rdata),
-  .mem_rstrb(is_ram & mem_rstrb),
-  .mem_wdata(mem_wdata),
-  .mem_wmask({4{is_ram}} & mem_wmask)
+  .mem_rstrb((is_ram & mem_rstrb) | dma_ram_rstrb),
+  .mem_wdata(dma_ram_wstrb ? dma_ram_wdata : mem_wdata),
+  .mem_wmask(dma_ram_wstrb ? 4'b1111 : {4{is_ram & mem_accept}} & mem_wmask)
 );
 
 wire [31:0] spi_rdata;
 wire spi_rbusy;
+wire spi_rstrb;
+wire spi_rword;
+wire [21:0] spi_word_addr;
+wire [3:0] spi_burst;
+wire spi_irbusy, spi_drbusy;
+wire arb_busy;
+
+// Flash addresses are 24 bits (up to 16 MB). The lower 4 MB of the flash
+// bus window, 0x800000, map the flash directly; the upper 4 MB, 0xC00000,
+// are the asset window onto 4 MB bank flash_bank (IO_BLOCK_FLASH reg 3).
+reg [1:0] flash_bank = 2'd0;
+wire [21:0] flash_iword = {imem_addr[22] ? flash_bank : 2'd0, imem_addr[21:2]};
+wire [21:0] flash_dword = {mem_addr[22] ? flash_bank : 2'd0, mem_addr[21:2]};
+wire [21:0] flash_xword = {dma_flash_addr[20] ? flash_bank : 2'd0, dma_flash_addr[19:0]};
 
-spi_flash flash (
+// Instruction reads of flash, straight or through the cache
+wire [31:0] flash_irdata;
+wire flash_irbusy;
+wire flash_istrb;
+wire [21:0] flash_iaddr;
+wire [3:0] flash_iburst;
+wire flash_ibusy;
+wire spi_irword;
+
+wire [31:0] icache_hits, icache_misses;
+wire icache_clear;
+
+generate
+if (ICACHE) begin : icache_on
+  icache cache (
+    .clk(CLK),
+    .rstrb(imem_is_spi & imem_rstrb),
+    .word_address(flash_iword),
+    .rdata(flash_irdata),
+    .rbusy(flash_irbusy),
+    .busy(flash_ibusy),
+    .fill_rstrb(flash_istrb),
+    .fill_address(flash_iaddr),
+    .fill_burst(flash_iburst),
+    .fill_rword(spi_irword),
+    .fill_rdata(spi_rdata),
+    .flush(flash_flush),
+    .clear(icache_clear),
+    .hits(icache_hits),
+    .misses(icache_misses)
+  );
+end else begin : icache_off
+  assign flash_istrb = imem_is_spi & imem_rstrb;
+  assign flash_iaddr = flash_iword;
+  assign flash_iburst = 4'd0;
+  assign flash_irdata = spi_rdata;
+  assign flash_irbusy = spi_irbusy;
+  assign flash_ibusy = 1'b0;
+  assign icache_hits = 32'b0;
+  assign icache_misses = 32'b0;
+end
+endgenerate
+
+// Data reads of flash, straight or through the line buffers
+wire [31:0] flash_drdata;
+wire flash_drbusy;
+wire flash_dstrb;
+wire [21:0] flash_daddr;
+wire [3:0] flash_dburst;
+wire flash_dbusy;
+wire spi_drword;
+
+generate
+if (FLASH_DBUF) begin : dbuf_on
+  flash_dbuf dbuf (
     .clk(CLK),
     .rstrb(is_spi & mem_rstrb),
-    .word_address(mem_word_addr[14:0]),
+    .word_address(flash_dword),
+    .rdata(flash_drdata),
+    .rbusy(flash_drbusy),
+    .busy(flash_dbusy),
+    .fill_rstrb(flash_dstrb),
+    .fill_address(flash_daddr),
+    .fill_burst(flash_dburst),
+    .fill_rword(spi_drword),
+    .fill_rdata(spi_rdata),
+    .flush(flash_flush)
+  );
+end else begin : dbuf_off
+  assign flash_dstrb = is_spi & mem_rstrb;
+  assign flash_daddr = flash_dword;
+  assign flash_dburst = 4'd0;
+  assign flash_drdata = spi_rdata;
+  assign flash_drbusy = spi_drbusy;
+  assign flash_dbusy = 1'b0;
+end
+endgenerate
+
+wire flash_busy = arb_busy | flash_ibusy | flash_dbusy;
+
+// Flash commands (IO_BLOCK_FLASH): CMD and DATA are sent MSB first, DATA
+// in memory byte order, when CTRL is written with the number of bits and
+// FLASH_CMD_WAIT. Cached flash words are dropped as the command starts.
+localparam FLASH_CMD_WAIT_BIT = 8;
+
+reg [31:0] flash_cmd;
+reg [31:0] flash_cmd_data;
+reg [6:0] flash_cmd_bits;
+reg flash_cmd_wait;
+reg flash_cmd_req = 1'b0;
+wire flash_cmd_grant;
+wire flash_cmd_rbusy;
+wire spi_cmd;
+wire [7:0] spi_status;
+wire flash_flush = flash_cmd_grant;
+
+always @(posedge CLK) begin
+    if (reset) begin
+        flash_cmd_req <= 1'b0;
+        flash_bank <= 2'd0;
+    end else begin
+        if (io_flash & mem_wstrb) begin
+            case (io_reg)
+                0: flash_cmd <= mem_wdata;
+                1: flash_cmd_data <= {mem_wdata[7:0], mem_wdata[15:8], mem_wdata[23:16], mem_wdata[31:24]};
+                2: begin
+                    flash_cmd_bits <= mem_wdata[6:0];
+                    flash_cmd_wait <= mem_wdata[FLASH_CMD_WAIT_BIT];
+                    flash_cmd_req <= 1'b1;
+                end
+                3: flash_bank <= mem_wdata[23:22];
+                default: ;
+            endcase
+        end
+        if (flash_cmd_grant)
+            flash_cmd_req <= 1'b0;
+    end
+end
+
+wire [31:0] flash_cmd_rdata = (io_reg == 3) ? {8'b0, flash_bank, 22'b0} :
+    {flash_cmd_req | flash_cmd_rbusy, 23'b0, spi_status};
+
+// DMA engine: takes the RAM data port on the cycles the core leaves it,
+// and on the cycles it writes (the core waits on ram_ready)
+wire dma_flash_req;
+wire [20:0] dma_flash_addr;
+wire [3:0] dma_flash_burst;
+wire dma_flash_grant;
+wire dma_flash_rword;
+
+wire dma_ram_rstrb;
+wire dma_ram_wstrb;
+wire [31:0] dma_ram_addr;
+wire [31:0] dma_ram_wdata;
+wire dma_ram = dma_ram_rstrb | dma_ram_wstrb;
+
+wire [31:0] dma_rdata;
+wire dma_finished;
+
+// OLED streaming drives SCK / MOSI and holds CS# low, DC high
+wire dma_oled;
+wire dma_oled_sck;
+wire dma_oled_mosi;
+
+generate
+if (DMA) begin : dma_on
+  dma dma (
+    .clk(CLK),
+    .reset(reset),
+    .wstrb(io_dma & mem_wstrb),
+    .reg_addr(io_reg[1:0]),
+    .wdata(mem_wdata),
+    .rdata(dma_rdata),
+    .finished(dma_finished),
+    .flash_req(dma_flash_req),
+    .flash_address(dma_flash_addr),
+    .flash_burst(dma_flash_burst),
+    .flash_grant(dma_flash_grant),
+    .flash_rword(dma_flash_rword),
+    .flash_rdata(spi_rdata),
+    .ram_free(~(is_ram & mem_req)),
+    .ram_rstrb(dma_ram_rstrb),
+    .ram_wstrb(dma_ram_wstrb),
+    .ram_addr(dma_ram_addr),
+    .ram_wdata(dma_ram_wdata),
+    .ram_rdata(ram_rdata),
+    .oled_active(dma_oled),
+    .oled_sck(dma_oled_sck),
+    .oled_mosi(dma_oled_mosi)
+  );
+end else begin : dma_off
+  assign dma_flash_req = 1'b0;
+  assign dma_flash_addr = 21'b0;
+  assign dma_flash_burst = 4'd0;
+  assign dma_ram_rstrb = 1'b0;
+  assign dma_ram_wstrb = 1'b0;
+  assign dma_ram_addr = 32'b0;
+  assign dma_ram_wdata = 32'b0;
+  assign dma_rdata = 32'b0;
+  assign dma_finished = 1'b0;
+  assign dma_oled = 1'b0;
+  assign dma_oled_sck = 1'b0;
+  assign dma_oled_mosi = 1'b0;
+end
+endgenerate
+
+flash_arbiter flash_arb (
+    .clk(CLK),
+    .i_rstrb(flash_istrb),
+    .i_word_address(flash_iaddr),
+    .i_burst(flash_iburst),
+    .i_rbusy(spi_irbusy),
+    .i_rword(spi_irword),
+    .d_rstrb(flash_dstrb),
+    .d_word_address(flash_daddr),
+    .d_burst(flash_dburst),
+    .d_rbusy(spi_drbusy),
+    .d_rword(spi_drword),
+    .x_req(dma_flash_req),
+    .x_word_address(flash_xword),
+    .x_burst(dma_flash_burst),
+    .x_grant(dma_flash_grant),
+    .x_rword(dma_flash_rword),
+    .c_req(flash_cmd_req),
+    .c_grant(flash_cmd_grant),
+    .c_rbusy(flash_cmd_rbusy),
+    .busy(arb_busy),
+    .rstrb(spi_rstrb),
+    .cmd(spi_cmd),
+    .word_address(spi_word_addr),
+    .burst(spi_burst),
+    .rbusy(spi_rbusy),
+    .rword(spi_rword)
+);
+
+// SCK source of spi_flash. The PLL locks long before por_count runs out.
+wire flash_clk;
+
+generate
+if (FLASH_PLL) begin : flash_pll
+  // 25 MHz * (DIVF + 1) / 2^DIVQ = 50 MHz
+  SB_PLL40_CORE #(
+    .FEEDBACK_PATH("SIMPLE"),
+    .DIVR(4'b0000),
+    .DIVF(7'b0011111),
+    .DIVQ(3'b100),
+    .FILTER_RANGE(3'b010)
+  ) pll (
+    .REFERENCECLK(CLK),
+    .PLLOUTGLOBAL(flash_clk),
+    .RESETB(1'b1),
+    .BYPASS(1'b0)
+  );
+end else begin : flash_no_pll
+  assign flash_clk = CLK;
+end
+endgenerate
+
+spi_flash #(
+    .FAST_READ(FLASH_FAST_READ),
+    .CS_HIGH_CYCLES(FLASH_PLL ? 6 : 3)
+) flash (
+    .clk(CLK),
+    .spi_clk_in(flash_clk),
+    .rstrb(spi_rstrb),
+    .word_address(spi_word_addr),
+    .burst(spi_burst),
     .rdata(spi_rdata),
     .rbusy(spi_rbusy),
+    .rword(spi_rword),
+    .cmd(spi_cmd),
+    .cmd_out({flash_cmd, flash_cmd_data}),
+    .cmd_bits(flash_cmd_bits),
+    .cmd_wait(flash_cmd_wait),
+    .status(spi_status),
     .spi_clk(SPI_CLK),
     .spi_cs_n(SPI_CS),
     .spi_mosi(SPI_MOSI),
     .spi_miso(SPI_MISO)
 );
 
-assign mem_rbusy = is_spi ? spi_rbusy : 1'b0;
+// Read data is steered by the target of the last read strobe rather than
+// by the current mem_addr, so the core may present its next address while
+// the previous word is still on mem_rdata.
+reg rd_ram, rd_spi;
+reg rd_pending; // a read was taken and has not been answered yet
+reg ird_spi;
+
+always @(posedge CLK) begin
+    if (reset) begin
+        rd_ram <= 1'b0;
+        rd_spi <= 1'b1;
+        rd_pending <= 1'b0;
+        ird_spi <= 1'b0;
+    end else begin
+        if (mem_rstrb) begin
+            rd_ram <= is_ram;
+            rd_spi <= is_spi;
+        end
+        rd_pending <= mem_rstrb | (rd_pending & ~mem_rvalid);
+        if (imem_rstrb)
+            ird_spi <= imem_is_spi;
+    end
+end
+
+// RAM, IO and buffered flash words answer on the cycle after the request,
+// other flash words once they have been read
+assign mem_rvalid = rd_pending & ~(rd_spi & flash_drbusy);
+
+assign imem_rdata = ird_spi ? flash_irdata : ram_irdata;
+assign imem_rbusy = ird_spi ? flash_irbusy : ram_irbusy;
 
 localparam IO_LEDS_BIT = 0;
 localparam IO_SEG_ONE_BIT = 1;
 localparam IO_SEG_TWO_BIT = 2;
 localparam IO_PMOD_BIT = 3;
 localparam IO_SW_BIT = 4;
+localparam IO_IRQ_BIT = 5;
+localparam IO_IRQ_EN_BIT = 6;
+localparam IO_ICACHE_HITS_BIT = 7;
+localparam IO_ICACHE_MISSES_BIT = 8;
+
+// Peripherals with several registers sit in blocks of 64 KB above the
+// one-hot ports of block 0, registers at mem_addr[5:2]
+localparam IO_BLOCK_DMA = 1;
+localparam IO_BLOCK_FLASH = 2;
+localparam IO_BLOCK_OLED_SPI = 3;
+localparam IO_BLOCK_TIMER = 4;
+localparam IO_BLOCK_SWITCH = 5;
+localparam IO_BLOCK_PRNG = 6;
+localparam IO_BLOCK_CORDIC = 7;
+
+wire [5:0] io_block = mem_addr[21:16];
+wire [3:0] io_reg = mem_addr[5:2];
+wire io_legacy = is_io & (io_block == 0);
+wire io_dma = is_io & (io_block == IO_BLOCK_DMA);
+wire io_flash = is_io & (io_block == IO_BLOCK_FLASH);
+wire io_oled_spi = is_io & (io_block == IO_BLOCK_OLED_SPI);
+wire io_timer = is_io & (io_block == IO_BLOCK_TIMER);
+wire io_switch = is_io & (io_block == IO_BLOCK_SWITCH);
+wire io_prng = is_io & (io_block == IO_BLOCK_PRNG);
+wire io_cordic = is_io & (io_block == IO_BLOCK_CORDIC);
+
+// Interrupt sources: one pending bit each, cleared by writing 1 to it
+// in IO_IRQ. The core sees their enabled OR as its external interrupt.
+localparam IRQ_SW_BIT = 0;  // a switch was pressed (or released, see debounce.v)
+localparam IRQ_DMA_BIT = 1; // a DMA copy is done
+localparam IRQ_TIMER_BIT = 2; // the timer deadline was reached
+localparam NB_IRQS = 3;
 
 /* Inputs */
 wire [3:0] switches;
@@ -87,6 +529,7 @@ reg [3:0] leds;
 reg [6:0] seg_one;
 reg [6:0] seg_two;
 reg [7:0] pmod_oled;
+reg [NB_IRQS-1:0] irq_enable;
 
 always @(posedge CLK) begin
     if (reset) begin
@@ -94,7 +537,8 @@ always @(posedge CLK) begin
         seg_one <= {7{1'b1}};
         seg_two <= {7{1'b1}};
         pmod_oled <= 8'b10000100;
-    end else if (is_io & mem_wstrb) begin
+        irq_enable <= {NB_IRQS{1'b0}};
+    end else if (io_legacy & mem_wstrb) begin
         if (mem_word_addr[IO_LEDS_BIT])
             leds <= mem_wdata[3:0];
         else if (mem_word_addr[IO_SEG_ONE_BIT])
@@ -103,23 +547,199 @@ always @(posedge CLK) begin
             seg_two <= mem_wdata[6:0];
         else if (mem_word_addr[IO_PMOD_BIT])
             pmod_oled <= mem_wdata[7:0];
+        else if (mem_word_addr[IO_IRQ_EN_BIT])
+            irq_enable <= mem_wdata[NB_IRQS-1:0];
+    end else if (io_dma & mem_rstrb) begin
+        io_rdata <= dma_rdata;
+    end else if (io_flash & mem_rstrb) begin
+        io_rdata <= flash_cmd_rdata;
+    end else if (io_oled_spi & mem_rstrb) begin
+        io_rdata <= oled_spi_rdata;
+    end else if (io_timer & mem_rstrb) begin
+        io_rdata <= timer_rdata;
+    end else if (io_switch & mem_rstrb) begin
+        io_rdata <= switch_rdata;
+    end else if (io_prng & mem_rstrb) begin
+        io_rdata <= prng_rdata;
+    end else if (io_cordic & mem_rstrb) begin
+        io_rdata <= cordic_rdata;
     end else if (is_io & mem_rstrb) begin
-        if (mem_word_addr[IO_SW_BIT])
+        if (~io_legacy)
+            io_rdata <= 32'b0;
+        else if (mem_word_addr[IO_SW_BIT])
             io_rdata <= switches;
+        else if (mem_word_addr[IO_IRQ_BIT])
+            io_rdata <= irq_pending;
+        else if (mem_word_addr[IO_IRQ_EN_BIT])
+            io_rdata <= irq_enable;
+        else if (mem_word_addr[IO_ICACHE_HITS_BIT])
+            io_rdata <= icache_hits;
+        else if (mem_word_addr[IO_ICACHE_MISSES_BIT])
+            io_rdata <= icache_misses;
     end
 end
 
+/* Interrupts */
+reg [3:0] sw_sync, sw_prev;
+reg [NB_IRQS-1:0] irq_pending;
+
+wire [NB_IRQS-1:0] irq_raise;
+assign irq_raise[IRQ_SW_BIT] = switch_changed;
+assign irq_raise[IRQ_DMA_BIT] = dma_finished;
+assign irq_raise[IRQ_TIMER_BIT] = timer_fired;
+
+wire irq_ack = io_legacy & mem_wstrb & mem_word_addr[IO_IRQ_BIT];
+
+// Writing either cache counter clears both
+assign icache_clear = io_legacy & mem_wstrb &
+    (mem_word_addr[IO_ICACHE_HITS_BIT] | mem_word_addr[IO_ICACHE_MISSES_BIT]);
+
+always @(posedge CLK) begin
+    sw_sync <= switches;
+    sw_prev <= sw_sync;
+
+    if (reset)
+        irq_pending <= {NB_IRQS{1'b0}};
+    else
+        irq_pending <= (irq_pending & ~({NB_IRQS{irq_ack}} & mem_wdata[NB_IRQS-1:0])) | irq_raise;
+end
+
+assign cpu_irq = |(irq_pending & irq_enable);
+
 assign switches = {SW1, SW2, SW3, SW4};
 
 assign {LED1, LED2, LED3, LED4} = leds;
 assign {S1_A, S1_B, S1_C, S1_D, S1_E, S1_F, S1_G} = seg_one;
 assign {S2_A, S2_B, S2_C, S2_D, S2_E, S2_F, S2_G} = seg_two;
+/* Switches */
+wire [31:0] switch_rdata;
+wire switch_changed;
+
+generate
+if (SW_DEBOUNCE) begin : debounce_on
+  debounce debounce (
+    .clk(CLK),
+    .reset(reset),
+    .switches(switches),
+    .wstrb(io_switch & mem_wstrb),
+    .reg_addr(io_reg[1:0]),
+    .wdata(mem_wdata),
+    .rdata(switch_rdata),
+    .changed(switch_changed)
+  );
+end else begin : debounce_off
+  assign switch_rdata = 32'b0;
+  assign switch_changed = |(sw_sync & ~sw_prev);
+end
+endgenerate
+
+/* Timer */
+wire [31:0] timer_rdata;
+wire timer_fired;
+
+generate
+if (TIMER) begin : timer_on
+  timer #(
+    .CLKS_PER_US(25)
+  ) timer (
+    .clk(CLK),
+    .reset(reset),
+    .wstrb(io_timer & mem_wstrb),
+    .reg_addr(io_reg[1:0]),
+    .wdata(mem_wdata),
+    .rdata(timer_rdata),
+    .fired(timer_fired)
+  );
+end else begin : timer_off
+  assign timer_rdata = 32'b0;
+  assign timer_fired = 1'b0;
+end
+endgenerate
+
+/* Random numbers */
+wire [31:0] prng_rdata;
+
+generate
+if (PRNG) begin : prng_on
+  prng prng (
+    .clk(CLK),
+    .reset(reset),
+    .wstrb(io_prng & mem_wstrb),
+    .reg_addr(io_reg[0]),
+    .wdata(mem_wdata),
+    .rdata(prng_rdata)
+  );
+end else begin : prng_off
+  assign prng_rdata = 32'b0;
+end
+endgenerate
+
+/* CORDIC */
+wire [31:0] cordic_rdata;
+wire cordic_busy;
+
+generate
+if (CORDIC) begin : cordic_on
+  cordic cordic (
+    .clk(CLK),
+    .reset(reset),
+    .wstrb(io_cordic & mem_wstrb),
+    .reg_addr(io_reg[1:0]),
+    .wdata(mem_wdata),
+    .rdata(cordic_rdata),
+    .busy(cordic_busy)
+  );
+end else begin : cordic_off
+  assign cordic_rdata = 32'b0;
+  assign cordic_busy = 1'b0;
+end
+endgenerate
+
+/* OLED SPI master */
+wire [31:0] oled_spi_rdata;
+wire oled_spi_full;
+wire oled_spi_enable;
+wire oled_spi_sck, oled_spi_mosi, oled_spi_cs_n, oled_spi_dc;
+
+generate
+if (OLED_SPI) begin : oled_spi_on
+  spi_master oled_spi (
+    .clk(CLK),
+    .reset(reset),
+    .wstrb(io_oled_spi & mem_wstrb),
+    .reg_addr(io_reg[1:0]),
+    .wdata(mem_wdata),
+    .rdata(oled_spi_rdata),
+    .full(oled_spi_full),
+    .hold(dma_oled),
+    .enable(oled_spi_enable),
+    .sck(oled_spi_sck),
+    .mosi(oled_spi_mosi),
+    .cs_n(oled_spi_cs_n),
+    .dc(oled_spi_dc)
+  );
+end else begin : oled_spi_off
+  assign oled_spi_rdata = 32'b0;
+  assign oled_spi_full = 1'b0;
+  assign oled_spi_enable = 1'b0;
+  assign {oled_spi_sck, oled_spi_mosi, oled_spi_cs_n, oled_spi_dc} = 4'b0010;
+end
+endgenerate
+
+// SCK, MOSI, CS# and D/C come from the DMA engine streaming to the OLED,
+// else from the SPI master when enabled, else from the PMOD register
+wire [7:0] pmod_dma = {1'b0, dma_oled_mosi, pmod_oled[5], dma_oled_sck,
+    1'b1, pmod_oled[2:0]};
+wire [7:0] pmod_spi = {oled_spi_cs_n, oled_spi_mosi, pmod_oled[5], oled_spi_sck,
+    oled_spi_dc, pmod_oled[2:0]};
+
 assign {OLED_CS, OLED_MOSI, OLED_NC, OLED_SCK,
-    OLED_DC, OLED_RES, OLED_VCC_EN, OLED_PMOD_EN} = pmod_oled;
+    OLED_DC, OLED_RES, OLED_VCC_EN, OLED_PMOD_EN} =
+    dma_oled ? pmod_dma : oled_spi_enable ? pmod_spi : pmod_oled;
 
 reg [31:0] io_rdata = 32'b0;
-assign mem_rdata = is_ram ? ram_rdata :
-    is_spi ? spi_rdata :
+assign mem_rdata = rd_ram ? ram_rdata :
+    rd_spi ? flash_drdata :
     io_rdata;
 
 endmodule
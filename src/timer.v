@@ -0,0 +1,82 @@
+`default_nettype none
+
+// A free-running microsecond counter and a compare register for
+// timestamps, delays and frame pacing that do not depend on where the code
+// runs (cycle counts come from mcycle). US counts from reset, ticked by a
+// prescaler of CLKS_PER_US. CMP is a deadline in microseconds: once US
+// reaches it (US - CMP >= 0, so a deadline already past fires at once)
+// expired is set and fired pulses for the IRQ_TIMER pending bit.
+//
+// Registers: 0 US (writable), 1 CMP (write arms it), 2 CTRL: write bit 0
+// to clear expired, bit 1 to disarm; reads {present, ..., armed, expired}.
+module timer #(
+  parameter CLKS_PER_US = 25
+) (
+  input clk,
+  input reset,
+
+  // Registers
+  input wstrb,
+  input [1:0] reg_addr,
+  input [31:0] wdata,
+  output reg [31:0] rdata,
+  output fired             // one cycle when the deadline is reached
+);
+
+localparam REG_US = 0;
+localparam REG_CMP = 1;
+localparam REG_CTRL = 2;
+
+localparam CTRL_EXPIRED = 0;
+localparam CTRL_DISARM = 1;
+
+localparam PRESCALE_BITS = $clog2(CLKS_PER_US);
+
+reg [31:0] us = 32'd0;
+reg [PRESCALE_BITS-1:0] prescale = 0;
+reg [31:0] cmp;
+reg armed = 1'b0;
+reg expired = 1'b0;
+
+wire tick = prescale == CLKS_PER_US - 1;
+wire [31:0] until = us - cmp;
+
+assign fired = armed & ~until[31];
+
+always @(*) begin
+    case (reg_addr)
+        REG_US: rdata = us;
+        REG_CMP: rdata = cmp;
+        default: rdata = {1'b1, 29'b0, armed, expired};
+    endcase
+end
+
+always @(posedge clk) begin
+    if (reset) begin
+        us <= 32'd0;
+        prescale <= 0;
+        armed <= 1'b0;
+        expired <= 1'b0;
+    end else begin
+        prescale <= tick ? 1'b0 : prescale + 1'b1;
+
+        if (wstrb & (reg_addr == REG_US))
+            us <= wdata;
+        else if (tick)
+            us <= us + 1'b1;
+
+        if (wstrb & (reg_addr == REG_CMP)) begin
+            cmp <= wdata;
+            armed <= 1'b1;
+            expired <= 1'b0;
+        end else if (fired) begin
+            armed <= 1'b0;
+            expired <= 1'b1;
+        end else if (wstrb & (reg_addr == REG_CTRL)) begin
+            if (wdata[CTRL_EXPIRED]) expired <= 1'b0;
+            if (wdata[CTRL_DISARM]) armed <= 1'b0;
+        end
+    end
+end
+
+endmodule